@@ -14,18 +14,20 @@
 #define HSIZ 67777
 //#define HSIZ 375559
 #define HBSIZ (256*2)
+// Width in bytes of the names and block pointers stored in the hash table.
+// 8 bytes so that texts, names and the table itself may exceed 2^32.
+#define PTRW ((int)sizeof(long))
 
+// All construction state lives in the hash table or on the stack of dbwt_bwt
+// so that several transforms can be computed concurrently.
 typedef struct {
-  int rest[HSIZ];
-  int head[HSIZ];
+  long rest[HSIZ];
+  long head[HSIZ];
   uchar *buf;
-  int bufsiz;
+  long bufsiz;
+  long collision;
 } htbl;
 
-htbl *h1;
-
-static long collision;
-
 static htbl *init_hashtable(void)
 {
   htbl *t;
@@ -41,14 +43,14 @@ static htbl *init_hashtable(void)
   }
   t->bufsiz = 0;
   t->buf = NULL;
-  collision = 0;
+  t->collision = 0;
   return t;
 }
 
-static int hfunc(int m, uchar *p)
+static int hfunc(long m, uchar *p)
 {
   ulong x;
-  int i;
+  long i;
 
   x = 0;
   for (i=0; i<m; i++) {
@@ -141,17 +143,17 @@ static int lenlen(ulong x)
 #define CONT 2
 
 // format: length (1 byte), string (m bytes)
-// if length==CONT, the following 4 bytes are the pointer to next element
+// if length==CONT, the following PTRW bytes are the pointer to next element
 // if length==0, end of list
 
-static int insert_string(htbl *t, int m, uchar *p)
+static int insert_string(htbl *t, long m, uchar *p)
 {
-  int i,l,l2;
+  long i,l,l2;
   int h;
   uchar *r,*r2;
   uchar *buf;
-  int q, pp, q2;
-  int w = sizeof(int); // length of name
+  long q, pp, q2;
+  int w = PTRW; // length of name
 
   buf = t->buf;
 
@@ -168,7 +170,7 @@ static int insert_string(htbl *t, int m, uchar *p)
     }
     if (l == CONT) {// end of block
       q = getpointer(r,w);
-      collision++;
+      t->collision++;
       continue;
     }
     if (l != m) {
@@ -176,7 +178,7 @@ static int insert_string(htbl *t, int m, uchar *p)
       q += l;
       q += 1; // for sentinel
       q += w; // for name
-      collision++;
+      t->collision++;
       continue;
     }
 
@@ -192,7 +194,7 @@ static int insert_string(htbl *t, int m, uchar *p)
     q += l;
     q += 1; // for sentinel
     q += w; // for name
-    collision++;
+    t->collision++;
   }
 
   if (m+lenlen(m)+1+w >= t->rest[h]-10) { // +1 stands for the space to store len
@@ -209,7 +211,7 @@ static int insert_string(htbl *t, int m, uchar *p)
     } else {
       r2 = &buf[pp];
       setlen(&r2,CONT);
-      setpointer(r2,q2,sizeof(w));
+      setpointer(r2,q2,w);
     }
     r = &buf[q2];
   }
@@ -227,14 +229,14 @@ static int insert_string(htbl *t, int m, uchar *p)
   return 1; // new string
 }
 
-static int getname(htbl *t, int m, uchar *p)
+static long getname(htbl *t, long m, uchar *p)
 {
-  int i,l,l2;
+  long i,l,l2;
   int h;
   uchar *r;
   uchar *buf;
-  int q;
-  int w = sizeof(int);
+  long q;
+  int w = PTRW;
 
   buf = t->buf;
 
@@ -287,7 +289,7 @@ static int getname(htbl *t, int m, uchar *p)
 static int LMS_compare(const void *p1, const void *p2)
 {
   int c1,c2;
-  int l1,l2;
+  long l1,l2;
   uchar *q1, *q2;
 
   q1 = *(uchar **)p1;  q2 = *(uchar **)p2;
@@ -314,13 +316,11 @@ static void printlstr(uchar *p)
   for (i=0; i<l-1; i++) printf("%c",p[i+1]);
 }
 */
-static uchar *min_ptr, *max_ptr;
-
-static uchar **sort_LMS(int n, htbl *h)
+static uchar **sort_LMS(long n, htbl *h)
 {
   uchar **s, *r, *q;
-  int p;
-  int i,j,l,m;
+  long p;
+  long i,j,l,m;
 
   s = (uchar **) dbwt_mymalloc((n+2) * sizeof(*s));
 //  dbwt_report_mem("allocate S* ptr");
@@ -343,17 +343,17 @@ static uchar **sort_LMS(int n, htbl *h)
       l = getlen(&r);
       if (l == 0) break;
       if (l == CONT) {
-        p = getpointer(r,sizeof(int));
+        p = getpointer(r,PTRW);
         continue;
       }
       if (j > n) {
-        printf("j = %d\n",j);
+        printf("j = %ld\n",j);
       }
       s[j++] = q;
       p += lenlen(l);
       p += 1; // for sentinel;
       p += l;
-      p += sizeof(int);
+      p += PTRW;
     }
   }
   m = j-1;
@@ -366,7 +366,7 @@ static uchar **sort_LMS(int n, htbl *h)
     l = getlen(&q);
     q += 1;
     q += l;
-    setpointer(q,(ulong)i,sizeof(int));
+    setpointer(q,(ulong)i,PTRW);
   }
   // \[ǵCS*  1  n-1 ̐
   // $  0 ɂ (ł͑ĂȂ)
@@ -378,7 +378,7 @@ static uchar **sort_LMS(int n, htbl *h)
 
 
 
-uchar * dbwt_bwt(uchar * T,long n,unsigned int *_last,unsigned int free_text)
+uchar * dbwt_bwt(uchar * T,long n,ulong *_last,unsigned int free_text)
 {
   long i,j;
   int t,tt;
@@ -389,6 +389,8 @@ uchar * dbwt_bwt(uchar * T,long n,unsigned int *_last,unsigned int free_text)
   int c;
   ulong last;
   uchar *lastptr;
+  uchar *min_ptr, *max_ptr;
+  htbl *h1;
 
   uchar **S;
   long C[SIGMA+2]; //  c n܂S*̐
@@ -399,7 +401,7 @@ uchar * dbwt_bwt(uchar * T,long n,unsigned int *_last,unsigned int free_text)
 
   dbwt_queue *Q[3][SIGMA+2];
 
-  uint *sa; // uint??
+  long *sa;
   long sa_size;
   uchar *bw;
   packed_array *T2;
@@ -513,13 +515,13 @@ uchar * dbwt_bwt(uchar * T,long n,unsigned int *_last,unsigned int free_text)
 
   { // T[0..p]  S* ł͂ȂBWϊɂ͕KvȂ̂ŕۑ
     uchar *r;
-    r = dbwt_myrealloc(h1->buf, h1->bufsiz + p+1+1+lenlen(p+1) + 4, h1->bufsiz);
+    r = dbwt_myrealloc(h1->buf, h1->bufsiz + p+1+1+lenlen(p+1) + PTRW, h1->bufsiz);
     if (r != h1->buf) {
 //      printf("buf has moved from %p to %p\n", h1->buf, r);
       h1->buf = r;
     }
     r = &h1->buf[h1->bufsiz];
-    h1->bufsiz += p+1+1+lenlen(p+1) + 4;
+    h1->bufsiz += p+1+1+lenlen(p+1) + PTRW;
 
     S = sort_LMS(s1, h1);
 
@@ -591,12 +593,12 @@ uchar * dbwt_bwt(uchar * T,long n,unsigned int *_last,unsigned int free_text)
 #endif
 
   sa_size=(n1+1)*sizeof(*sa);
-  sa = (uint *) dbwt_mymalloc(sa_size);
+  sa = (long *) dbwt_mymalloc(sa_size);
 //  dbwt_report_mem("allocate sa");
 ////////////////////////////////////
 // T2[1..n1] ̐̕ڔz쐬
 //  printf("sorting level-1 suffixes using IS...\n");
-  dbwt_sais_main((const unsigned char *) T2->b, (int *)sa, 0, n1, s1+1, -T2->w);
+  dbwt_sais_main((const unsigned char *) T2->b, sa, 0, n1, s1+1, -T2->w);
 
   for (i=0; i<n1; i++) {
     sa[i]++; // sa[i]  1  s1
@@ -608,7 +610,7 @@ uchar * dbwt_bwt(uchar * T,long n,unsigned int *_last,unsigned int free_text)
   bwp_w = dbwt_blog(max_ptr - min_ptr + 2)+1;
 
   for (i=0; i<n1; i++) {
-    int l;
+    long l;
     uchar *q;
     p = sa[i];
     q = S[dbwt_pa_get(T2,p-1)]; // bw[i] = T2[sa[i]-1] ̕
@@ -1,11 +1,12 @@
 #ifndef dbwt_h
 #define dbwt_h
+#include <stddef.h>
 #ifndef uchar
 typedef unsigned char uchar;
 #endif
-int dbwt_sais_main(const unsigned char *T, int *SA, int fs, int n, int k, int cs);
-int dbwt_sais_int(const int *T, int *SA, int n, int k);
-int dbwt_sais(const unsigned char *T, int *SA, int n);
+int dbwt_sais_main(const unsigned char *T, long *SA, long fs, long n, long k, int cs);
+int dbwt_sais_int(const long *T, long *SA, long n, long k);
+int dbwt_sais(const unsigned char *T, long *SA, long n);
 /**
  * Performs bwt on a given unsigned char array.
  *
@@ -16,6 +17,14 @@ int dbwt_sais(const unsigned char *T, int *SA, int n);
  *
  * @return Burrows-Wheeler transformed unsigned char array
  */
-uchar * dbwt_bwt(uchar * T,long n,unsigned int *_last,unsigned int free_text);
+uchar * dbwt_bwt(uchar * T,long n,unsigned long *_last,unsigned int free_text);
+
+/**
+ * Peak number of bytes allocated by dbwt in the calling thread since the
+ * last call to dbwt_reset_peak_alloc. dbwt_bwt is reentrant, so each thread
+ * running a transform sees only its own allocations.
+ */
+size_t dbwt_peak_alloc(void);
+void dbwt_reset_peak_alloc(void);
 
 #endif
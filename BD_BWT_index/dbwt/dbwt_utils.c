@@ -19,7 +19,10 @@ int l;
   return l;
 }
 
-size_t dbwt_cur_alloc=0, dbwt_max_alloc=0;
+// Allocation counters are per thread so that concurrent dbwt_bwt calls
+// neither race on them nor see each other's usage.
+__thread size_t dbwt_cur_alloc=0, dbwt_max_alloc=0;
+static __thread size_t dbwt_peak_base=0;
 void * dbwt_mymalloc(size_t n)
 {
   void *p;
@@ -69,6 +72,16 @@ void dbwt_report_mem(char *s)
 }
 
 
+size_t dbwt_peak_alloc(void)
+{
+  return dbwt_max_alloc - dbwt_peak_base;
+}
+
+void dbwt_reset_peak_alloc(void)
+{
+  dbwt_peak_base = dbwt_max_alloc = dbwt_cur_alloc;
+}
+
 void dbwt_myfree(void *p, size_t s)
 {
   free(p);
@@ -114,12 +127,23 @@ int dbwt_getbit(pb *B, ulong i)
 }
 
 #if 1
-dword dbwt_getbits(pb *B, ulong i, int d)
+ulong dbwt_getbits(pb *B, ulong i, int d)
 {
   qword x,z;
+  ulong y;
+  int d2;
 
   B += (i >> logD);
   i &= (D-1);
+  if (d >= 2*D) { // Only for texts large enough to need 32-bit or wider values
+    y = 0;
+    while (d > 0) {
+      d2 = min(D-(int)i, d);
+      y = (y << d2) | ((B[0] >> (D-i-d2)) & ((1UL<<d2)-1));
+      d -= d2;  i = 0;  B++;
+    }
+    return y;
+  }
   if (i+d <= 2*D) {
     x = (((qword)B[0]) << D) + B[1];
     x <<= i;
@@ -139,7 +163,7 @@ dword dbwt_getbits(pb *B, ulong i, int d)
   return x;
 }
 #else
-dword dbwt_getbits(pb *B, ulong i, int d)
+ulong dbwt_getbits(pb *B, ulong i, int d)
 {
   dword j,x;
 
@@ -170,7 +194,7 @@ int dbwt_setbits(pb *B, ulong i, int d, ulong x)
     *B = (*B & (~m)) | y;
     B++;  i=0;
     d -= d2;
-    x &= (1<<d)-1; // x ̏ʃrbg
+    x &= (1UL<<d)-1; // x ̏ʃrbg
   }
   m = (1<<d)-1;
   y = x << (D-i-d);
@@ -201,7 +225,7 @@ packed_array * dbwt_allocate_packed_array(ulong n, int w)
   ulong i,x;
   packed_array *p;
 
-  if (w >= 32) {
+  if (w > 8*(int)sizeof(ulong)) {
     printf("warning: w=%d\n",w);
   }
 
@@ -51,9 +51,9 @@ void * dbwt_mymalloc(size_t n);
 void * dbwt_myrealloc(void *ptr, size_t new, size_t old);
 void  dbwt_myfree(void *p, size_t s);
 void dbwt_report_mem(char *s);
-extern size_t dbwt_cur_alloc, dbwt_max_alloc;
+extern __thread size_t dbwt_cur_alloc, dbwt_max_alloc;
 
-unsigned int dbwt_getbits(unsigned short *B, unsigned long i, int d);
+unsigned long dbwt_getbits(unsigned short *B, unsigned long i, int d);
 
 typedef struct {
   ulong n;
@@ -70,6 +70,6 @@ void dbwt_pa_set(packed_array *p, ulong i, long x);
 pb * dbwt_allocate_vector(ulong n);
 int dbwt_getbit(pb *B, ulong i);
 int dbwt_setbit(pb *B, ulong i,int x);
-dword dbwt_getbits(pb *B, ulong i, int d);
+ulong dbwt_getbits(pb *B, ulong i, int d);
 int dbwt_setbits(pb *B, ulong i, int d, ulong x);
 #endif
@@ -27,30 +27,31 @@
 #include <stdlib.h>
 #include "dbwt_utils.h"
 
-static unsigned int get2(unsigned short *B, unsigned long i, int d)
+static unsigned long get2(unsigned short *B, unsigned long i, int d)
 {
   unsigned short *b;
 
   b = B + (i>>4)*d;
   i = (i % 16)*d;
-  return (unsigned int) dbwt_getbits(b,i,d);
+  return (unsigned long) dbwt_getbits(b,i,d);
 }
 
 //#define chr(i) (cs == sizeof(int) ? ((const int *)T)[i]:((const unsigned char *)T)[i])
-#define chr(i) ((cs == sizeof(int)) ? (((const int *)T)[i]):(get2((unsigned short *)T,i+1,-cs)))
+// Suffixes, names and lengths are longs so that the level-1 string of dbwt may exceed 2^31 symbols
+#define chr(i) ((cs == sizeof(long)) ? (((const long *)T)[i]):((long)get2((unsigned short *)T,i+1,-cs)))
 
 /* find the start or end of each bucket */
 static
 void
-getCounts(const unsigned char *T, int *C, int n, int k, int cs) {
-  int i;
+getCounts(const unsigned char *T, long *C, long n, long k, int cs) {
+  long i;
   for(i = 0; i < k; ++i) { C[i] = 0; }
   for(i = 0; i < n; ++i) { ++C[chr(i)]; }
 }
 static
 void
-getBuckets(const int *C, int *B, int k, int end) {
-  int i, sum = 0;
+getBuckets(const long *C, long *B, long k, int end) {
+  long i, sum = 0;
   if(end) { for(i = 0; i < k; ++i) { sum += C[i]; B[i] = sum; } }
   else { for(i = 0; i < k; ++i) { sum += C[i]; B[i] = sum - C[i]; } }
 }
@@ -58,9 +59,9 @@ getBuckets(const int *C, int *B, int k, int end) {
 /* compute SA */
 static
 void
-induceSA(const unsigned char *T, int *SA, int *C, int *B, int n, int k, int cs) {
-  int *b, i, j;
-  int c0, c1;
+induceSA(const unsigned char *T, long *SA, long *C, long *B, long n, long k, int cs) {
+  long *b, i, j;
+  long c0, c1;
   /* compute SAl */
   if(C == B) { getCounts(T, C, n, k, cs); }
   getBuckets(C, B, k, 0); /* find starts of buckets */
@@ -93,18 +94,18 @@ induceSA(const unsigned char *T, int *SA, int *C, int *B, int n, int k, int cs)
    use a working space (excluding T and SA) of at most 2n+O(1) for a constant alphabet */
 //static
 int
-dbwt_sais_main(const unsigned char *T, int *SA, int fs, int n, int k, int cs) {
-  int *C, *B, *RA;
-  int i, j, c, m, p, q, plen, qlen, name;
-  int c0, c1;
-  int diff;
+dbwt_sais_main(const unsigned char *T, long *SA, long fs, long n, long k, int cs) {
+  long *C, *B, *RA;
+  long i, j, c, m, p, q, plen, qlen, name;
+  long c0, c1;
+  long diff;
 
 //  printf("sais n=%d k=%d\n",n,k);
 
   /* stage 1: reduce the problem by at least 1/2
      sort all the S-substrings */
   if(k <= fs) { C = SA + n; B = (k <= (fs - k)) ? C + k : C; }
-  else if((C = B = (int *) dbwt_mymalloc(k * sizeof(int))) == NULL) { return -2; }
+  else if((C = B = (long *) dbwt_mymalloc(k * sizeof(long))) == NULL) { return -2; }
   getCounts(T, C, n, k, cs); getBuckets(C, B, k, 1); /* find ends of buckets */
   for(i = 0; i < n; ++i) { SA[i] = 0; }
   for(i = n - 2, c = 0, c1 = chr(n - 1); 0 <= i; --i, c1 = c0) {
@@ -113,7 +114,7 @@ dbwt_sais_main(const unsigned char *T, int *SA, int fs, int n, int k, int cs) {
   }
   //printf("induceSA n=%d\n",n);
   induceSA(T, SA, C, B, n, k, cs);
-  if(fs < k) { dbwt_myfree(C,k * sizeof(int)); }
+  if(fs < k) { dbwt_myfree(C,k * sizeof(long)); }
 
   //printf("compacting\n");
   /* compact all the sorted substrings into the first m items of SA
@@ -150,7 +151,7 @@ dbwt_sais_main(const unsigned char *T, int *SA, int fs, int n, int k, int cs) {
     for(i = n - 1, j = m - 1; m <= i; --i) {
       if(SA[i] != 0) { RA[j--] = SA[i] - 1; }
     }
-    if(dbwt_sais_main((unsigned char *)RA, SA, fs + n - m * 2, m, name, sizeof(int)) != 0) { return -2; }
+    if(dbwt_sais_main((unsigned char *)RA, SA, fs + n - m * 2, m, name, sizeof(long)) != 0) { return -2; }
     for(i = n - 2, j = m - 1, c = 0, c1 = chr(n - 1); 0 <= i; --i, c1 = c0) {
       if((c0 = chr(i)) < (c1 + c)) { c = 1; }
       else if(c != 0) { RA[j--] = i + 1, c = 0; } /* get p1 */
@@ -160,7 +161,7 @@ dbwt_sais_main(const unsigned char *T, int *SA, int fs, int n, int k, int cs) {
 
   /* stage 3: induce the result for the original problem */
   if(k <= fs) { C = SA + n; B = (k <= (fs - k)) ? C + k : C; }
-  else if((C = B = (int *) dbwt_mymalloc(k * sizeof(int))) == NULL) { return -2; }
+  else if((C = B = (long *) dbwt_mymalloc(k * sizeof(long))) == NULL) { return -2; }
   /* put all left-most S characters into their buckets */
   getCounts(T, C, n, k, cs); getBuckets(C, B, k, 1); /* find ends of buckets */
   for(i = m; i < n; ++i) { SA[i] = 0; } /* init SA[m..n-1] */
@@ -170,21 +171,21 @@ dbwt_sais_main(const unsigned char *T, int *SA, int fs, int n, int k, int cs) {
   }
 //  printf("induceSA n=%d\n",n);
   induceSA(T, SA, C, B, n, k, cs);
-  if(fs < k) { dbwt_myfree(C,k * sizeof(int)); }
+  if(fs < k) { dbwt_myfree(C,k * sizeof(long)); }
 
   return 0;
 }
 
 int
-dbwt_sais(const unsigned char *T, int *SA, int n) {
+dbwt_sais(const unsigned char *T, long *SA, long n) {
   if((T == NULL) || (SA == NULL) || (n < 0)) { return -1; }
   if(n <= 1) { if(n == 1) { SA[0] = 0; } return 0; }
   return dbwt_sais_main(T, SA, 0, n, 256, sizeof(unsigned char));
 }
 
 int
-dbwt_sais_int(const int *T, int *SA, int n, int k) {
+dbwt_sais_int(const long *T, long *SA, long n, long k) {
   if((T == NULL) || (SA == NULL) || (n < 0) || (k <= 0)) { return -1; }
   if(n <= 1) { if(n == 1) { SA[0] = 0; } return 0; }
-  return dbwt_sais_main((const unsigned char *)T, SA, 0, n, k, sizeof(int));
+  return dbwt_sais_main((const unsigned char *)T, SA, 0, n, k, sizeof(long));
 }
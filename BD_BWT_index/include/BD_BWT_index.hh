@@ -5,8 +5,431 @@
 #include <vector>
 #include <utility>
 #include <string>
+#include <thread>
+#include <chrono>
+#include <exception>
+#include <iostream>
+#include <fstream>
+#include <cstring>
+#include <memory>
+#include <algorithm>
+#include <iomanip>
+#include <unistd.h>
+#include <sys/mman.h>
 #include "bwt.hh"
 #include "Interval.hh"
+#include "Checksum_stream.hh"
+#include "Mapped_bit_vector.hh"
+#include "DNA_bwt.hh"
+
+/*
+ * Options for the construction of a BD_BWT_index.
+ *
+ * In parallel mode the forward BWT and wavelet tree are built in one thread and the
+ * reverse BWT and wavelet tree in another, which roughly halves the wall-clock time but
+ * doubles the peak memory. If max_memory_bytes is positive and the estimated peak of
+ * the parallel construction exceeds it, the construction falls back to sequential mode.
+ *
+ * In semi-external mode the suffix arrays are built on disk in tmp_dir with sdsl's
+ * construct_sa_se and the BWTs are streamed to disk, so that only the text being sorted
+ * and the wavelet trees are held in memory. It is about four times slower, but needs only
+ * about half of the memory of the in-memory construction. If max_memory_bytes is positive and the estimated
+ * peak of the sequential in-memory construction exceeds it, semi-external mode is used.
+ * Semi-external construction is always sequential.
+ */
+class BD_BWT_index_construction_config{
+public:
+    bool parallel;
+    bool semi_external;
+    int64_t max_memory_bytes; // Zero or negative means no limit
+    std::string tmp_dir; // Directory for the temporary files of semi-external construction
+    bool print_timings; // Print the per-phase timings to stderr after construction
+    BD_BWT_index_construction_config() : parallel(false), semi_external(false), max_memory_bytes(0), tmp_dir("."), print_timings(false) {}
+};
+
+/*
+ * Wall-clock times in seconds and memory usage of the phases of the construction.
+ * In parallel mode the forward and reverse phases overlap, so total_seconds is less
+ * than the sum of the phases.
+ */
+class BD_BWT_index_construction_stats{
+public:
+    bool parallel; // Whether the construction actually ran in parallel
+    bool semi_external; // Whether the construction actually ran in semi-external mode
+    double forward_bwt_seconds, reverse_bwt_seconds;
+    double forward_wt_seconds, reverse_wt_seconds;
+    double total_seconds;
+    int64_t forward_dbwt_peak_bytes, reverse_dbwt_peak_bytes; // Peak allocation of dbwt
+    int64_t estimated_peak_bytes; // Estimated peak memory of the whole construction
+    BD_BWT_index_construction_stats() : parallel(false), semi_external(false), forward_bwt_seconds(0), reverse_bwt_seconds(0),
+        forward_wt_seconds(0), reverse_wt_seconds(0), total_seconds(0), forward_dbwt_peak_bytes(0),
+        reverse_dbwt_peak_bytes(0), estimated_peak_bytes(0) {}
+    void print(std::ostream& out) const{
+        out << "BD_BWT_index construction (" << (parallel ? "parallel" : "sequential")
+            << (semi_external ? ", semi-external" : "") << ")\n"
+            << "  forward BWT:          " << forward_bwt_seconds << " s, dbwt peak " << forward_dbwt_peak_bytes << " bytes\n"
+            << "  reverse BWT:          " << reverse_bwt_seconds << " s, dbwt peak " << reverse_dbwt_peak_bytes << " bytes\n"
+            << "  forward wavelet tree: " << forward_wt_seconds << " s\n"
+            << "  reverse wavelet tree: " << reverse_wt_seconds << " s\n"
+            << "  total:                " << total_seconds << " s, estimated peak " << estimated_peak_bytes << " bytes" << std::endl;
+    }
+};
+
+/*
+ * The extensions of a string by one character, filled by BD_BWT_index::left_extensions and
+ * right_extensions: the characters in the order of the BWT rows, i.e. END first, and the interval
+ * pairs of the extended strings. Reuse one object between calls to avoid allocation.
+ */
+class BD_BWT_index_extensions{
+public:
+    int64_t count; // Number of extensions
+    std::vector<uint8_t> symbols; // The characters in [0..count)
+    std::vector<Interval_pair> intervals; // The interval pairs in [0..count)
+    std::vector<uint64_t> ranks_i, ranks_j; // Ranks at the interval endpoints from interval_symbols
+    BD_BWT_index_extensions() : count(0), symbols(256), intervals(256), ranks_i(256), ranks_j(256) {}
+};
+
+// The extensions of a batch of interval pairs. Those of pair k are at [begin[k]..begin[k+1]) of
+// symbols and intervals, in the order of the alphabet.
+class BD_BWT_index_batch_extensions{
+public:
+    std::vector<int64_t> begin;
+    std::vector<uint8_t> symbols;
+    std::vector<Interval_pair> intervals;
+};
+
+/*
+ * Starts loading the memory that rank queries at position i of the BWT read into the cache. For the
+ * sdsl wavelet trees this is the root level; Extension_batch descends the lower levels of many
+ * queries together. DNA_bwt loads all that a rank query reads. Does nothing for other BWT types.
+ */
+template<class t_bwt>
+inline void prefetch_bwt_rank(const t_bwt& bwt, uint64_t i) {}
+
+// Position i of the bitvector of a wavelet tree and, for rank_support_v and Mapped_rank_support_il,
+// the counts that cover it. Does nothing for other bitvector types.
+template<class t_bitvector, class t_rank>
+inline void prefetch_bv_rank(const t_bitvector& bv, const t_rank& rank, uint64_t i) {}
+template<class t_rank>
+inline void prefetch_bv_rank(const sdsl::bit_vector& bv, const t_rank& rank, uint64_t i) { __builtin_prefetch(bv.data() + i / 64); }
+inline void prefetch_bv_rank(const sdsl::bit_vector& bv, const sdsl::rank_support_v<>& rank, uint64_t i) { rank.prefetch(i); }
+template<uint32_t t_bs>
+inline void prefetch_bv_rank(const Mapped_bit_vector_il<t_bs>& bv, const Mapped_rank_support_il<1, t_bs>& rank, uint64_t i) { rank.prefetch(i); }
+
+template<class t_shape, class t_bitvector, class t_rank, class t_select, class t_select_zero, class t_tree>
+inline void prefetch_bwt_rank(const sdsl::wt_pc<t_shape, t_bitvector, t_rank, t_select, t_select_zero, t_tree>& bwt, uint64_t i){
+    prefetch_bv_rank(bwt.bv, bwt.bv_rank, i); // The root is first in the bitvector
+}
+
+inline void prefetch_bwt_rank(const DNA_bwt& bwt, uint64_t i) { bwt.prefetch(i); }
+
+// The ranks of a character at both ends of an interval and the number of smaller characters in it
+class Extension_counts{
+public:
+    uint64_t rank_left, rank_right; // Equal if the character does not occur in the interval
+    int64_t smaller;
+    Extension_counts() : rank_left(0), rank_right(0), smaller(0) {}
+};
+
+// A character that occurs in interval k of a batch, with its ranks at both ends of the interval
+class Interval_symbol{
+public:
+    int64_t k;
+    uint8_t symbol;
+    uint64_t rank_i, rank_j;
+};
+
+// A request of the level-synchronous descent of Extension_batch: the range of interval k in the
+// bitvector of node v
+class Extension_task{
+public:
+    int64_t k;
+    uint64_t v;
+    uint64_t i, j;
+    bool on_path; // Counts: v is on the path of the character of the request
+};
+
+// The space of the batched queries, reused between the calls of a thread
+class Extension_batch_workspace{
+public:
+    std::vector<Extension_task> tasks, next;
+    std::vector<Extension_counts> counts;
+    std::vector<Interval_symbol> found, by_level;
+    std::vector<int64_t> offsets;
+    std::vector<uint8_t> symbols; // For interval_symbols
+    std::vector<uint64_t> ranks_i, ranks_j;
+    Extension_batch_workspace() : symbols(256), ranks_i(256), ranks_j(256) {}
+
+    static Extension_batch_workspace& local(){
+        static thread_local Extension_batch_workspace workspace;
+        return workspace;
+    }
+};
+
+/*
+ * The batched queries of BD_BWT_index on one BWT, for the intervals on the given side (forward or
+ * reverse) of the interval pairs of the batch:
+ *  - count: the Extension_counts of symbols[k] in interval k, where the smaller characters are
+ *    those before it in the alphabet (END first). A character outside of the alphabet does not occur.
+ *  - symbols: the characters of every interval into workspace.found, grouped by interval in the
+ *    order of the batch, in no particular order within an interval.
+ *  - two_symbols: whether interval k has at least two distinct characters.
+ * Empty intervals have no characters. This version answers the requests one at a time and loads the
+ * memory of the request eight positions later into the cache meanwhile, which covers all that a rank
+ * query of DNA_bwt reads. init is called with the BWT after the construction and loading of the index.
+ */
+template<class t_bwt>
+class Serial_extension_batch{
+    enum { PREFETCH_DISTANCE = 8 };
+
+    template<class t_function>
+    void for_each_prefetched(const t_bwt& bwt, const Interval_pair* intervals, Interval Interval_pair::* side, int64_t n,
+                             t_function f) const{
+        for(int64_t k = 0; k < n && k < PREFETCH_DISTANCE; k++){
+            prefetch_bwt_rank(bwt, (intervals[k].*side).left);
+            prefetch_bwt_rank(bwt, (intervals[k].*side).right + 1);
+        }
+        for(int64_t k = 0; k < n; k++){
+            if(k + PREFETCH_DISTANCE < n){
+                const Interval& ahead = intervals[k + PREFETCH_DISTANCE].*side;
+                prefetch_bwt_rank(bwt, ahead.left);
+                prefetch_bwt_rank(bwt, ahead.right + 1);
+            }
+            f(k, intervals[k].*side);
+        }
+    }
+
+public:
+    std::vector<uint8_t> alphabet;
+
+    void init(const t_bwt& bwt, const std::vector<uint8_t>& alphabet){ this->alphabet = alphabet; }
+
+    void count(const t_bwt& bwt, const Interval_pair* intervals, Interval Interval_pair::* side, const uint8_t* symbols,
+               int64_t n, Extension_counts* counts, Extension_batch_workspace& workspace) const{
+        for_each_prefetched(bwt, intervals, side, n, [&](int64_t k, const Interval& I){
+            uint8_t c = symbols[k];
+            counts[k] = Extension_counts();
+            if(I.size() == 0) return;
+            counts[k].rank_left = bwt.rank(I.left, c);
+            counts[k].rank_right = bwt.rank(I.right + 1, c);
+            for(uint8_t d : alphabet){
+                if(d == c) break;
+                counts[k].smaller += bwt.rank(I.right + 1, d) - bwt.rank(I.left, d);
+            }
+        });
+    }
+
+    void symbols(const t_bwt& bwt, const Interval_pair* intervals, Interval Interval_pair::* side, int64_t n,
+                 Extension_batch_workspace& workspace) const{
+        workspace.found.clear();
+        for_each_prefetched(bwt, intervals, side, n, [&](int64_t k, const Interval& I){
+            if(I.size() == 0) return;
+            sdsl::int_vector_size_type count;
+            bwt.interval_symbols(I.left, I.right + 1, count, workspace.symbols, workspace.ranks_i, workspace.ranks_j);
+            for(int64_t i = 0; i < (int64_t)count; i++)
+                workspace.found.push_back({k, workspace.symbols[i], workspace.ranks_i[i], workspace.ranks_j[i]});
+        });
+    }
+
+    void two_symbols(const t_bwt& bwt, const Interval_pair* intervals, Interval Interval_pair::* side, int64_t n,
+                     std::vector<bool>& result, Extension_batch_workspace& workspace) const{
+        for_each_prefetched(bwt, intervals, side, n, [&](int64_t k, const Interval& I){
+            result[k] = false;
+            if(I.size() < 2) return;
+            auto rank_and_symbol = bwt.inverse_select(I.left);
+            result[k] = (int64_t)(bwt.rank(I.right + 1, rank_and_symbol.second) - rank_and_symbol.first) < I.size();
+        });
+    }
+};
+
+// Other BWT types than wavelet trees are queried serially
+template<class t_bwt>
+class Extension_batch : public Serial_extension_batch<t_bwt> {};
+
+/*
+ * The wavelet tree version descends the tree one level at a time for all requests of the batch
+ * together. A task is a request at a node with the range of its interval in the bitvector of the
+ * node. When a task is created, the rank memory of its range is prefetched, and it is read only after
+ * the tasks of all the other requests at the level have been created, so the cache misses of the
+ * requests overlap at every level instead of only at the root.
+ *  - count follows the path of the character, which is dropped when its range becomes empty, and
+ *    the subtrees that hold both characters smaller than it and other characters. A subtree of only
+ *    smaller characters adds its whole range to the count without a descent.
+ *  - symbols follows every nonempty range down to the leaves, like interval_symbols.
+ *  - two_symbols follows the only nonempty range until a node splits the range in two.
+ * The nodes are numbered by wt_pc in level order. init copies the tree into a table of nodes, so
+ * that the descent reads one small table instead of the tree of wt_pc.
+ */
+template<class t_shape, class t_bitvector, class t_rank, class t_select, class t_select_zero, class t_tree>
+class Extension_batch<sdsl::wt_pc<t_shape, t_bitvector, t_rank, t_select, t_select_zero, t_tree>>{
+    typedef sdsl::wt_pc<t_shape, t_bitvector, t_rank, t_select, t_select_zero, t_tree> t_wt;
+    typedef typename t_wt::node_type node_type;
+
+    class Node{
+    public:
+        uint64_t start, ones_before; // Of the bitvector of the node in bv
+        uint64_t child[2];
+        int64_t min_order, max_order; // Of the characters of the subtree in the alphabet
+        bool leaf;
+        uint8_t symbol; // Of a leaf
+    };
+
+    std::vector<Node> nodes; // Indexed by the node ids of wt_pc
+    std::vector<int64_t> order; // Of every byte in the alphabet, the size of the alphabet if it is not in it
+    std::vector<std::pair<uint64_t, uint64_t>> paths; // Length and bits of the path of every byte, the root level highest
+    Serial_extension_batch<t_wt> serial; // For a tree whose root is a leaf
+
+    void collect_nodes(const t_wt& wt, node_type v){
+        if((int64_t)nodes.size() <= (int64_t)v) nodes.resize(v + 1);
+        Node node = Node();
+        node.leaf = wt.is_leaf(v);
+        if(node.leaf){
+            node.symbol = wt.sym(v);
+            node.min_order = node.max_order = order[node.symbol];
+        } else{
+            auto children = wt.expand(v);
+            for(int64_t b = 0; b < 2; b++){
+                collect_nodes(wt, children[b]);
+                node.child[b] = children[b];
+            }
+            node.start = wt.bv_pos(v);
+            node.ones_before = wt.bv_pos_rank(v);
+            node.min_order = std::min(nodes[node.child[0]].min_order, nodes[node.child[1]].min_order);
+            node.max_order = std::max(nodes[node.child[0]].max_order, nodes[node.child[1]].max_order);
+        }
+        nodes[v] = node;
+    }
+
+    void add_task(const t_wt& wt, const Extension_task& task, std::vector<Extension_task>& tasks) const{
+        const Node& node = nodes[task.v];
+        prefetch_bv_rank(wt.bv, wt.bv_rank, node.start + task.i);
+        prefetch_bv_rank(wt.bv, wt.bv_rank, node.start + task.j);
+        tasks.push_back(task);
+    }
+
+    // Splits the range of the task into the ranges of the children of its node. A range of one
+    // character needs one rank query and the bit of the character.
+    void split(const t_wt& wt, const Extension_task& task, uint64_t* child_i, uint64_t* child_j) const{
+        const Node& node = nodes[task.v];
+        uint64_t ones_i = wt.bv_rank(node.start + task.i) - node.ones_before;
+        uint64_t ones_j = task.j - task.i == 1 ? ones_i + wt.bv[node.start + task.i]
+                                               : wt.bv_rank(node.start + task.j) - node.ones_before;
+        child_i[0] = task.i - ones_i; child_i[1] = ones_i;
+        child_j[0] = task.j - ones_j; child_j[1] = ones_j;
+    }
+
+    // The tasks at the root of the nonempty intervals of at least min_size characters
+    void start(const t_wt& wt, const Interval_pair* intervals, Interval Interval_pair::* side, int64_t n, int64_t min_size,
+               std::vector<Extension_task>& tasks) const{
+        tasks.clear();
+        for(int64_t k = 0; k < n; k++){
+            const Interval& I = intervals[k].*side;
+            if(I.size() == 0 || I.size() < min_size) continue;
+            add_task(wt, {k, wt.root(), (uint64_t)I.left, (uint64_t)I.right + 1, false}, tasks);
+        }
+    }
+
+public:
+    void init(const t_wt& wt, const std::vector<uint8_t>& alphabet){
+        serial.alphabet = alphabet;
+        order.assign(256, alphabet.size());
+        for(int64_t i = 0; i < (int64_t)alphabet.size(); i++) order[alphabet[i]] = i;
+        paths.resize(256);
+        for(int64_t c = 0; c < 256; c++) paths[c] = wt.path(c); // Length 0 if c does not occur
+        nodes.clear();
+        if(wt.sigma >= 2) collect_nodes(wt, wt.root());
+    }
+
+    void count(const t_wt& wt, const Interval_pair* intervals, Interval Interval_pair::* side, const uint8_t* symbols,
+               int64_t n, Extension_counts* counts, Extension_batch_workspace& workspace) const{
+        if(nodes.empty()) return serial.count(wt, intervals, side, symbols, n, counts, workspace);
+        std::vector<Extension_task>& tasks = workspace.tasks;
+        std::vector<Extension_task>& next = workspace.next;
+        for(int64_t k = 0; k < n; k++) counts[k] = Extension_counts();
+        start(wt, intervals, side, n, 1, tasks);
+        for(Extension_task& task : tasks) task.on_path = paths[symbols[task.k]].first > 0;
+
+        for(uint64_t level = 0; !tasks.empty(); level++){
+            next.clear();
+            for(const Extension_task& task : tasks){
+                uint64_t child_i[2], child_j[2];
+                split(wt, task, child_i, child_j);
+                int64_t c = order[symbols[task.k]];
+                const std::pair<uint64_t, uint64_t>& path = paths[symbols[task.k]];
+                uint64_t path_bit = task.on_path ? (path.second >> (path.first - 1 - level)) & 1 : 0;
+                for(uint64_t b = 0; b < 2; b++){
+                    const Node& child = nodes[nodes[task.v].child[b]];
+                    if(child_j[b] == child_i[b]) continue; // Also ends the path of the character
+                    Extension_task child_task = {task.k, nodes[task.v].child[b], child_i[b], child_j[b], task.on_path && path_bit == b};
+                    if(child_task.on_path){
+                        if(child.leaf){
+                            counts[task.k].rank_left = child_i[b];
+                            counts[task.k].rank_right = child_j[b];
+                        } else add_task(wt, child_task, next);
+                    } else if(child.max_order < c) counts[task.k].smaller += child_j[b] - child_i[b];
+                    else if(child.min_order < c) add_task(wt, child_task, next); // Not a leaf
+                }
+            }
+            tasks.swap(next);
+        }
+    }
+
+    void symbols(const t_wt& wt, const Interval_pair* intervals, Interval Interval_pair::* side, int64_t n,
+                 Extension_batch_workspace& workspace) const{
+        if(nodes.empty()) return serial.symbols(wt, intervals, side, n, workspace);
+        std::vector<Extension_task>& tasks = workspace.tasks;
+        std::vector<Extension_task>& next = workspace.next;
+        std::vector<Interval_symbol>& found = workspace.by_level;
+        found.clear();
+        start(wt, intervals, side, n, 1, tasks);
+        while(!tasks.empty()){
+            next.clear();
+            for(const Extension_task& task : tasks){
+                uint64_t child_i[2], child_j[2];
+                split(wt, task, child_i, child_j);
+                for(uint64_t b = 0; b < 2; b++){
+                    if(child_j[b] == child_i[b]) continue;
+                    const Node& child = nodes[nodes[task.v].child[b]];
+                    if(child.leaf) found.push_back({task.k, child.symbol, child_i[b], child_j[b]});
+                    else add_task(wt, {task.k, nodes[task.v].child[b], child_i[b], child_j[b], false}, next);
+                }
+            }
+            tasks.swap(next);
+        }
+
+        // Group by interval with a counting sort
+        std::vector<int64_t>& offsets = workspace.offsets;
+        offsets.assign(n + 1, 0);
+        for(const Interval_symbol& x : found) offsets[x.k + 1]++;
+        for(int64_t k = 0; k < n; k++) offsets[k + 1] += offsets[k];
+        workspace.found.resize(found.size());
+        for(const Interval_symbol& x : found) workspace.found[offsets[x.k]++] = x;
+    }
+
+    void two_symbols(const t_wt& wt, const Interval_pair* intervals, Interval Interval_pair::* side, int64_t n,
+                     std::vector<bool>& result, Extension_batch_workspace& workspace) const{
+        if(nodes.empty()) return serial.two_symbols(wt, intervals, side, n, result, workspace);
+        std::vector<Extension_task>& tasks = workspace.tasks;
+        std::vector<Extension_task>& next = workspace.next;
+        for(int64_t k = 0; k < n; k++) result[k] = false;
+        start(wt, intervals, side, n, 2, tasks);
+        while(!tasks.empty()){
+            next.clear();
+            for(const Extension_task& task : tasks){
+                uint64_t child_i[2], child_j[2];
+                split(wt, task, child_i, child_j);
+                bool left = child_j[0] > child_i[0], right = child_j[1] > child_i[1];
+                if(left && right) result[task.k] = true;
+                else{
+                    uint64_t b = right;
+                    if(!nodes[nodes[task.v].child[b]].leaf)
+                        add_task(wt, {task.k, nodes[task.v].child[b], child_i[b], child_j[b], false}, next);
+                }
+            }
+            tasks.swap(next);
+        }
+    }
+};
 
 /*
  * Implements a bidictional BWT index for a byte alphabet.
@@ -17,38 +440,87 @@
  * C[c] is the number of characters with lexicographical rank strictly less than c at the given interval. 
  * If the interval spans the whole BWT, the array is called the global C-array,
  * else it's called a local C-array.
+ *
+ * The BWTs are stored in t_bwt, which answers access, rank and interval_symbols queries like an
+ * sdsl wavelet tree. The default is a Huffman-shaped wavelet tree over t_bitvector. DNA_bwt is
+ * faster for alphabets of at most 8 characters, such as DNA; t_bitvector is unused with it.
+ *
+ * The const member functions have no shared mutable state, so one index can be queried from
+ * many threads at once. Functions that need space take it from the caller or use thread-local space.
  */
 
-template<class t_bitvector = sdsl::bit_vector>
+template<class t_bitvector = sdsl::bit_vector, class t_bwt = sdsl::wt_huff<t_bitvector>>
 class BD_BWT_index{
     
 private:
         
-    sdsl::wt_huff<t_bitvector> forward_bwt;
-    sdsl::wt_huff<t_bitvector> reverse_bwt;
+    t_bwt forward_bwt;
+    t_bwt reverse_bwt;
 
     std::vector<int64_t> global_c_array;
     std::vector<uint8_t> alphabet;
+    BD_BWT_index_construction_stats construction_stats;
+    std::shared_ptr<Mapped_file> mapping; // The file that a memory-mapped index points into, if any
+    Extension_batch<t_bwt> forward_batch, reverse_batch; // Filled by init_batches
+    
+    void construct(const uint8_t* input, int64_t n, std::vector<uint8_t>* text, const BD_BWT_index_construction_config& config);
+    void build_direction(uint8_t* text, int64_t n, bool reverse, t_bwt& wt,
+                         double& bwt_seconds, double& wt_seconds, int64_t& dbwt_peak_bytes);
+    void build_direction_semi_external(const uint8_t* input, int64_t n, bool reverse, t_bwt& wt,
+                                       const std::string& tmp_dir, double& bwt_seconds, double& wt_seconds);
+    static int64_t estimate_construction_peak_bytes(int64_t n, bool parallel);
+    static int64_t estimate_semi_external_peak_bytes(int64_t n);
+    static double seconds_since(std::chrono::steady_clock::time_point start);
     
-    std::vector<uint8_t> get_string_alphabet(const uint8_t* s) const;
-    int64_t strlen(const uint8_t* str) const;
-    int64_t compute_cumulative_char_rank_in_interval(const sdsl::wt_huff<t_bitvector>& wt, uint8_t c, Interval I) const;
-    std::vector<uint8_t> get_interval_symbols(const sdsl::wt_huff<t_bitvector>& wt, Interval I) const;
-    void get_interval_symbols(const sdsl::wt_huff<t_bitvector>& wt, Interval I, sdsl::int_vector_size_type& nExtensions, 
+    template<class T> static void write_value(std::ostream& out, const T& x){ out.write((const char*)&x, sizeof(T)); }
+    template<class T> static void read_value(std::istream& in, T& x){ in.read((char*)&x, sizeof(T)); }
+    void load_header(std::istream& in);
+    void load_payload(std::istream& in);
+    static std::vector<uint8_t> get_string_alphabet(const uint8_t* s, int64_t n);
+    static std::vector<uint8_t> sorted_alphabet(const std::vector<bool>& found);
+    static int64_t strlen(const uint8_t* str);
+    int64_t compute_cumulative_char_rank_in_interval(const t_bwt& wt, uint8_t c, Interval I) const;
+    void get_interval_symbols(const t_bwt& wt, Interval I, sdsl::int_vector_size_type& nExtensions, 
                               std::vector<uint8_t>& symbols, std::vector<uint64_t>& ranks_i, std::vector<uint64_t>& ranks_j) const;
-    void count_smaller_chars(const sdsl::wt_huff<t_bitvector>& bwt, std::vector<int64_t>& counts, Interval I) const;
+    void count_smaller_chars(const t_bwt& bwt, std::vector<int64_t>& counts, Interval I) const;
+    bool has_two_distinct_symbols(const t_bwt& wt, Interval I) const;
+    void extensions(const t_bwt& wt, Interval I, Interval other, bool left, BD_BWT_index_extensions& result) const;
+    Interval_pair left_extend_by(Interval_pair intervals, uint8_t c, int64_t count_smaller) const;
+    Interval_pair right_extend_by(Interval_pair intervals, uint8_t c, int64_t count_smaller) const;
+    void init_batches();
+    void extensions_batch(const Extension_batch<t_bwt>& batch, const t_bwt& wt, const Interval_pair* intervals, int64_t n,
+                          bool left, BD_BWT_index_batch_extensions& result) const;
 
 public:
 
     // The input string must not contain the END byte
     static const uint8_t END = 0x01; // End of string marker.
-    BD_BWT_index(const uint8_t* input);
+    
+    // Serialization format identifier. Increment the version whenever the layout written by serialize changes.
+    static const char* serialization_magic() { return "BDBWTIDX"; }
+    static const uint32_t SERIALIZATION_VERSION = 1;
+    
+    BD_BWT_index() {} // An empty index. Fill it with load.
+    
+    // Builds the index of the NUL-terminated input string.
+    BD_BWT_index(const uint8_t* input, const BD_BWT_index_construction_config& config = BD_BWT_index_construction_config());
+    
+    // Builds the index of input[0..n-1], which may contain any bytes except END, including 0x00.
+    // Makes one working copy of the input for dbwt, two in parallel mode.
+    BD_BWT_index(const uint8_t* input, int64_t n, const BD_BWT_index_construction_config& config = BD_BWT_index_construction_config());
+    
+    // Builds the index of the text, using the storage of the vector as the working copy of dbwt
+    // instead of copying the input. The text is consumed: it is reversed in place for the reverse
+    // BWT and released after the construction. Reserve one byte more than the length of the text
+    // to avoid a reallocation. Semi-external and parallel construction still copy.
+    BD_BWT_index(std::vector<uint8_t>&& text, const BD_BWT_index_construction_config& config = BD_BWT_index_construction_config());
     
     int64_t size() const { return forward_bwt.size();}
     uint8_t forward_bwt_at(int64_t index) const { return forward_bwt[index]; }
     uint8_t backward_bwt_at(int64_t index) const { return reverse_bwt[index]; }
     const std::vector<int64_t>& get_global_c_array() const { return global_c_array; }
-    const std::vector<uint8_t>& get_alphabet() const { return alphabet; }
+    const std::vector<uint8_t>& get_alphabet() const { return alphabet; } // END first, then the other bytes in increasing order
+    const BD_BWT_index_construction_stats& get_construction_stats() const { return construction_stats; }
 
     // Computes the local C-array of the given forward interval into the parameter vector. The size
     // of the parameter vector must be at least 256
@@ -60,10 +532,9 @@ public:
 
     // Computes the interval pair of the left extension of the given intervals by the character c.
     // Returns an interval of size zero if the extension is not possible or if the given interval has size 0.
-    // Internally, the function computes the local C-array of the interval. 
-    // To avoid recomputing the local C-array multiple times for the same interval, 
-    // use the version of the function that takes the C-array as a parameter.
-    // NOT THREAD SAFE
+    // Internally, the function counts the characters smaller than c in the interval.
+    // To extend the same interval by many characters, use left_extensions or
+    // the version of the function that takes the local C-array as a parameter.
     Interval_pair left_extend(Interval_pair intervals, uint8_t c) const;
     
     // A version of left_extend that takes a precomputed local forward c-array as a parameter. Useful
@@ -71,11 +542,27 @@ public:
     Interval_pair left_extend(Interval_pair intervals, uint8_t c, const std::vector<int64_t>& local_c_array) const;
 
     // Analogous right extensions to left extensions
-    // NOT THREAD SAFE
     Interval_pair right_extend(Interval_pair intervals, uint8_t c) const;
     // Takes a precomputed local reverse c-array as a parameter.
     Interval_pair right_extend(Interval_pair intervals, uint8_t c, const std::vector<int64_t>& local_c_array) const;
 
+    // Extends intervals[k] to the left by symbols[k] into results[k] for every k in [0..n), like
+    // left_extend. With wavelet trees the requests descend the trees together one level at a time,
+    // so that their cache misses overlap (see Extension_batch).
+    void left_extend_batch(const Interval_pair* intervals, const uint8_t* symbols, int64_t n, Interval_pair* results) const;
+    
+    // Analogous right extensions
+    void right_extend_batch(const Interval_pair* intervals, const uint8_t* symbols, int64_t n, Interval_pair* results) const;
+    
+    // Starts loading the memory that left_extensions and right_extensions of the interval pair
+    // read first into the cache. Call it some time before the extensions.
+    void prefetch(Interval_pair intervals) const{
+        prefetch_bwt_rank(forward_bwt, intervals.forward.left);
+        prefetch_bwt_rank(forward_bwt, intervals.forward.right + 1);
+        prefetch_bwt_rank(reverse_bwt, intervals.reverse.left);
+        prefetch_bwt_rank(reverse_bwt, intervals.reverse.right + 1);
+    }
+
     // Let s be a suffix of length k with lexicographic rank lex_rank among all suffixes of the input string.
     // Returns the lexicographic rank of the suffix with length k+1 if k is not equal to the length of the
     // input string counting the terminating symbol, or the lexicographic rank of the suffix with length 0 otherwise.
@@ -86,28 +573,193 @@ public:
     // input string counting the terminating symbol, or the colexicographic rank of the prefix with length 0 otherwise.
     int64_t forward_step(int64_t colex_rank) const;
     
+    // Computes all left extensions cW of the string W with the given interval pair, including the
+    // extension by END, into result with one interval_symbols query on the forward BWT. The ranks
+    // taken are proportional to the number of extensions, not to the size of the alphabet.
+    void left_extensions(Interval_pair intervals, BD_BWT_index_extensions& result) const;
+    
+    // Analogous right extensions with one interval_symbols query on the reverse BWT
+    void right_extensions(Interval_pair intervals, BD_BWT_index_extensions& result) const;
+    
+    // Computes left_extensions(intervals[k]) for every k in [0..n) into result, descending the wavelet
+    // trees with all the intervals together like left_extend_batch
+    void left_extensions_batch(const Interval_pair* intervals, int64_t n, BD_BWT_index_batch_extensions& result) const;
+    
+    // Analogous right extensions
+    void right_extensions_batch(const Interval_pair* intervals, int64_t n, BD_BWT_index_batch_extensions& result) const;
+    
+    // Whether the string has at least two right (left) extensions. Take two rank queries and
+    // allocate nothing, whatever the number of distinct extensions.
     bool is_right_maximal(Interval_pair I) const;
     bool is_left_maximal(Interval_pair I) const;
+    
+    // Computes is_right_maximal(intervals[k]) (is_left_maximal) into result[k] for every k in [0..n),
+    // like left_extend_batch
+    void is_right_maximal_batch(const Interval_pair* intervals, int64_t n, std::vector<bool>& result) const;
+    void is_left_maximal_batch(const Interval_pair* intervals, int64_t n, std::vector<bool>& result) const;
+    
+    // Writes the index to the stream: a header with the format version and the bitvector type,
+    // the wavelet trees, the global C-array and the alphabet, and a checksum of everything
+    // after the header. Returns the number of bytes written.
+    int64_t serialize(std::ostream& out) const;
+    
+    // Replaces the contents of the index with an index written by serialize. Throws std::runtime_error
+    // if the stream does not contain an index of the same format version and bitvector type, or if
+    // the checksum does not match.
+    void load(std::istream& in);
+    
+    void store_to_file(const std::string& filename) const;
+    void load_from_file(const std::string& filename);
+    
+    // Loads an index file written by store_to_file by memory-mapping it. With the bitvector type
+    // Mapped_bit_vector_il the wavelet trees are used in place from the mapping, so loading takes
+    // constant time and the pages are shared between processes; other bitvector types are copied.
+    // The checksum is verified only if verify_checksum is true, because that reads the whole file.
+    void load_mapped(const std::string& filename, bool verify_checksum = false);
 
 };
 
-template<class t_bitvector>
-const uint8_t BD_BWT_index<t_bitvector>::END;
+template<class t_bitvector, class t_bwt>
+const uint32_t BD_BWT_index<t_bitvector, t_bwt>::SERIALIZATION_VERSION;
+
+template<class t_bitvector, class t_bwt>
+const uint8_t BD_BWT_index<t_bitvector, t_bwt>::END;
+
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index<t_bitvector, t_bwt>::serialize(std::ostream& out) const{
+    int64_t written = 0;
+    std::string bitvector_type = sdsl::util::class_name(forward_bwt);
+    out.write(serialization_magic(), 8);
+    write_value(out, SERIALIZATION_VERSION);
+    write_value(out, (uint64_t)bitvector_type.size());
+    out.write(bitvector_type.data(), bitvector_type.size());
+    written += 8 + sizeof(uint32_t) + sizeof(uint64_t) + bitvector_type.size();
+    
+    Checksum_ostreambuf checksum_buf(out.rdbuf());
+    std::ostream payload(&checksum_buf);
+    written += forward_bwt.serialize(payload);
+    written += reverse_bwt.serialize(payload);
+    write_value(payload, (uint64_t)global_c_array.size());
+    payload.write((const char*)global_c_array.data(), global_c_array.size() * sizeof(int64_t));
+    write_value(payload, (uint64_t)alphabet.size());
+    payload.write((const char*)alphabet.data(), alphabet.size());
+    written += 2*sizeof(uint64_t) + global_c_array.size() * sizeof(int64_t) + alphabet.size();
+    
+    write_value(out, checksum_buf.checksum());
+    written += sizeof(uint64_t);
+    if(!payload || !out) throw std::runtime_error("Failed to write BD_BWT_index");
+    return written;
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::load_header(std::istream& in){
+    char magic[8];
+    uint32_t version = 0;
+    uint64_t type_length = 0;
+    in.read(magic, 8);
+    if(!in || std::memcmp(magic, serialization_magic(), 8) != 0)
+        throw std::runtime_error("Not a BD_BWT_index file");
+    read_value(in, version);
+    if(!in || version != SERIALIZATION_VERSION){
+        std::stringstream error;
+        error << "Unsupported BD_BWT_index format version " << version << ", expected " << SERIALIZATION_VERSION;
+        throw std::runtime_error(error.str());
+    }
+    read_value(in, type_length);
+    if(!in || type_length > 4096) throw std::runtime_error("Corrupted BD_BWT_index header");
+    std::string bitvector_type(type_length, ' ');
+    in.read(&bitvector_type[0], bitvector_type.size());
+    if(!in || bitvector_type != sdsl::util::class_name(forward_bwt))
+        throw std::runtime_error("BD_BWT_index was serialized with a different bitvector type: " + bitvector_type);
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::load_payload(std::istream& in){
+    forward_bwt.load(in);
+    reverse_bwt.load(in);
+    uint64_t c_array_size = 0, alphabet_size = 0;
+    read_value(in, c_array_size);
+    if(!in || c_array_size != 256) throw std::runtime_error("Corrupted BD_BWT_index: bad C-array");
+    global_c_array.resize(c_array_size);
+    in.read((char*)global_c_array.data(), c_array_size * sizeof(int64_t));
+    read_value(in, alphabet_size);
+    if(!in || alphabet_size > 256) throw std::runtime_error("Corrupted BD_BWT_index: bad alphabet");
+    alphabet.resize(alphabet_size);
+    in.read((char*)alphabet.data(), alphabet_size);
+    if(in) init_batches();
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::load(std::istream& in){
+    load_header(in);
+    Checksum_istreambuf checksum_buf(in.rdbuf());
+    std::istream payload(&checksum_buf);
+    load_payload(payload);
+    
+    uint64_t stored_checksum = 0;
+    read_value(in, stored_checksum);
+    if(!payload || !in) throw std::runtime_error("Truncated BD_BWT_index");
+    if(stored_checksum != checksum_buf.checksum()) throw std::runtime_error("BD_BWT_index checksum mismatch");
+    mapping.reset();
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::store_to_file(const std::string& filename) const{
+    std::ofstream out(filename, std::ios::binary);
+    if(!out.good()) throw std::runtime_error("Could not open " + filename + " for writing");
+    serialize(out);
+}
 
-template<class t_bitvector>
-void BD_BWT_index<t_bitvector>::compute_local_c_array_forward(Interval& interval, std::vector<int64_t>& c_array) const{
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::load_from_file(const std::string& filename){
+    std::ifstream in(filename, std::ios::binary);
+    if(!in.good()) throw std::runtime_error("Could not open " + filename);
+    load(in);
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::load_mapped(const std::string& filename, bool verify_checksum){
+    std::shared_ptr<Mapped_file> file = std::make_shared<Mapped_file>(filename);
+    const char* end = file->begin() + file->size();
+    Mapped_streambuf buf(file->begin(), end);
+    std::istream in(&buf);
+    load_header(in);
+    if(buf.remaining() < (int64_t)sizeof(uint64_t)) throw std::runtime_error("Truncated BD_BWT_index");
+    
+    uint64_t stored_checksum = 0;
+    std::memcpy(&stored_checksum, end - sizeof(uint64_t), sizeof(uint64_t));
+    if(verify_checksum){
+        FNV1a_hash hash;
+        hash.update(buf.current(), buf.remaining() - sizeof(uint64_t));
+        if(hash.value != stored_checksum) throw std::runtime_error("BD_BWT_index checksum mismatch");
+    }
+    
+    try{
+        load_payload(in);
+        if(!in || buf.remaining() != (int64_t)sizeof(uint64_t)) throw std::runtime_error("Truncated BD_BWT_index");
+    } catch(...){
+        // Do not leave the wavelet trees pointing into the mapping that is about to be unmapped
+        forward_bwt = t_bwt();
+        reverse_bwt = t_bwt();
+        throw;
+    }
+    mapping = file;
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::compute_local_c_array_forward(Interval& interval, std::vector<int64_t>& c_array) const{
     assert(c_array.size() >= 256);
     count_smaller_chars(forward_bwt, c_array, interval);
 }
 
-template<class t_bitvector>
-void BD_BWT_index<t_bitvector>::compute_local_c_array_reverse(Interval& interval, std::vector<int64_t>& c_array) const{
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::compute_local_c_array_reverse(Interval& interval, std::vector<int64_t>& c_array) const{
     assert(c_array.size() >= 256);
     count_smaller_chars(reverse_bwt, c_array, interval);
 }
 
-template<class t_bitvector>
-int64_t BD_BWT_index<t_bitvector>::compute_cumulative_char_rank_in_interval(const sdsl::wt_huff<t_bitvector>& wt, uint8_t c, Interval I) const{
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index<t_bitvector, t_bwt>::compute_cumulative_char_rank_in_interval(const t_bwt& wt, uint8_t c, Interval I) const{
     int64_t ans = 0;
     if(I.size() == 0) return 0;
     
@@ -120,29 +772,12 @@ int64_t BD_BWT_index<t_bitvector>::compute_cumulative_char_rank_in_interval(cons
 }
 
 
-template<class t_bitvector>
-std::vector<uint8_t> BD_BWT_index<t_bitvector>::get_interval_symbols(const sdsl::wt_huff<t_bitvector>& wt, Interval I) const{
-    if(I.size() == 0){
-        std::vector<uint8_t> empty;
-        return empty;
-    }
-    
-    sdsl::int_vector_size_type nExtensions;
-    std::vector<uint8_t> symbols(wt.sigma);
-    std::vector<uint64_t> ranks_i(wt.sigma);
-    std::vector<uint64_t> ranks_j(wt.sigma);
-    wt.interval_symbols(I.left, I.right+1, nExtensions, symbols, ranks_i, ranks_j);
-    while(symbols.size() > nExtensions) symbols.pop_back();
-    return symbols;
-}
-
-// Another version of get_interval_symbols when the allocation of a new vector is too slow.
 // Counts the number of distinct symbols into nExtensions, and puts the symbols into the indices
 // [0,nExtensions[ of symbols. Also stores ranks of the symbols at the endpoints of the interval I
 // to ranks_i and ranks_j. Important: All the parameter vectors must have length at least equal to the size
 // of the alphabet of the given wavelet tree. Symbols is not sorted
-template<class t_bitvector>
-void BD_BWT_index<t_bitvector>::get_interval_symbols(const sdsl::wt_huff<t_bitvector>& wt, Interval I, sdsl::int_vector_size_type& nExtensions, std::vector<uint8_t>& symbols,
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::get_interval_symbols(const t_bwt& wt, Interval I, sdsl::int_vector_size_type& nExtensions, std::vector<uint8_t>& symbols,
  std::vector<uint64_t>& ranks_i, std::vector<uint64_t>& ranks_j) const{
     if(I.size() == 0){
         nExtensions = 0;
@@ -154,37 +789,75 @@ void BD_BWT_index<t_bitvector>::get_interval_symbols(const sdsl::wt_huff<t_bitve
 
 
 // Takes a backward step in the forward bwt
-template<class t_bitvector>
-int64_t BD_BWT_index<t_bitvector>::backward_step(int64_t lex_rank) const{
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index<t_bitvector, t_bwt>::backward_step(int64_t lex_rank) const{
     uint8_t c = forward_bwt[lex_rank];
     return global_c_array[c] + forward_bwt.rank(lex_rank, c);
 }
 
 // Takes a backward step in the reverse bwt
-template<class t_bitvector>
-int64_t BD_BWT_index<t_bitvector>::forward_step(int64_t colex_rank) const{
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index<t_bitvector, t_bwt>::forward_step(int64_t colex_rank) const{
     uint8_t c = reverse_bwt[colex_rank];
     return global_c_array[c] + reverse_bwt.rank(colex_rank, c);
 }
 
-template<class t_bitvector>
-Interval_pair BD_BWT_index<t_bitvector>::left_extend(Interval_pair intervals, uint8_t c) const{
-    static std::vector<int64_t> local_c_array(256); // NOT THREAD SAFE
-    compute_local_c_array_forward(intervals.forward, local_c_array);
-    return left_extend(intervals,c,local_c_array);
+template<class t_bitvector, class t_bwt>
+Interval_pair BD_BWT_index<t_bitvector, t_bwt>::left_extend(Interval_pair intervals, uint8_t c) const{
+    return left_extend_by(intervals, c, compute_cumulative_char_rank_in_interval(forward_bwt, c, intervals.forward));
 }
 
 
-template<class t_bitvector>
-Interval_pair BD_BWT_index<t_bitvector>::right_extend(Interval_pair intervals, uint8_t c) const{
-    static std::vector<int64_t> local_c_array(256); // NOT THREAD SAFE
-    compute_local_c_array_reverse(intervals.reverse, local_c_array);
-    return right_extend(intervals,c,local_c_array);
+template<class t_bitvector, class t_bwt>
+Interval_pair BD_BWT_index<t_bitvector, t_bwt>::right_extend(Interval_pair intervals, uint8_t c) const{
+    return right_extend_by(intervals, c, compute_cumulative_char_rank_in_interval(reverse_bwt, c, intervals.reverse));
 }
 
-template<class t_bitvector>
-Interval_pair BD_BWT_index<t_bitvector>::left_extend(Interval_pair intervals, uint8_t c, const std::vector<int64_t>& local_c_array) const{
+template<class t_bitvector, class t_bwt>
+Interval_pair BD_BWT_index<t_bitvector, t_bwt>::left_extend(Interval_pair intervals, uint8_t c, const std::vector<int64_t>& local_c_array) const{
     assert(local_c_array.size() >= 256);
+    return left_extend_by(intervals, c, local_c_array[c]);
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::left_extend_batch(const Interval_pair* intervals, const uint8_t* symbols, int64_t n,
+                                                         Interval_pair* results) const{
+    Extension_batch_workspace& workspace = Extension_batch_workspace::local();
+    std::vector<Extension_counts>& counts = workspace.counts;
+    counts.resize(n);
+    forward_batch.count(forward_bwt, intervals, &Interval_pair::forward, symbols, n, counts.data(), workspace);
+    for(int64_t k = 0; k < n; k++){
+        const Extension_counts& x = counts[k];
+        results[k] = Interval_pair(-1,-2,-1,-2);
+        if(x.rank_right == x.rank_left) continue; // Also if the interval is empty
+        int64_t start_f_new = global_c_array[symbols[k]] + x.rank_left;
+        int64_t start_r_new = intervals[k].reverse.left + x.smaller;
+        int64_t size = x.rank_right - x.rank_left;
+        results[k] = Interval_pair(start_f_new, start_f_new + size - 1, start_r_new, start_r_new + size - 1);
+    }
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::right_extend_batch(const Interval_pair* intervals, const uint8_t* symbols, int64_t n,
+                                                          Interval_pair* results) const{
+    Extension_batch_workspace& workspace = Extension_batch_workspace::local();
+    std::vector<Extension_counts>& counts = workspace.counts;
+    counts.resize(n);
+    reverse_batch.count(reverse_bwt, intervals, &Interval_pair::reverse, symbols, n, counts.data(), workspace);
+    for(int64_t k = 0; k < n; k++){
+        const Extension_counts& x = counts[k];
+        results[k] = Interval_pair(-1,-2,-1,-2);
+        if(x.rank_right == x.rank_left) continue; // Also if the interval is empty
+        int64_t start_r_new = global_c_array[symbols[k]] + x.rank_left;
+        int64_t start_f_new = intervals[k].forward.left + x.smaller;
+        int64_t size = x.rank_right - x.rank_left;
+        results[k] = Interval_pair(start_f_new, start_f_new + size - 1, start_r_new, start_r_new + size - 1);
+    }
+}
+
+// Left extension when the number of characters smaller than c in the forward interval is known
+template<class t_bitvector, class t_bwt>
+Interval_pair BD_BWT_index<t_bitvector, t_bwt>::left_extend_by(Interval_pair intervals, uint8_t c, int64_t count_smaller) const{
     if(intervals.forward.size() == 0)
         return Interval_pair(-1,-2,-1,-2);
     
@@ -199,15 +872,21 @@ Interval_pair BD_BWT_index<t_bitvector>::left_extend(Interval_pair intervals, ui
     if(start_f_new > end_f_new) return Interval_pair(-1,-2,-1,-2); // num_c_in_interval == 0
     
     // Compute the new reverse interval
-    int64_t start_r_new = reverse.left + local_c_array[c];
+    int64_t start_r_new = reverse.left + count_smaller;
     int64_t end_r_new = start_r_new + (end_f_new - start_f_new); // The forward and reverse intervals must have same length
     
     return Interval_pair(start_f_new,end_f_new,start_r_new,end_r_new);
 }
 
-template<class t_bitvector>
-Interval_pair BD_BWT_index<t_bitvector>::right_extend(Interval_pair intervals, uint8_t c, const std::vector<int64_t>& local_c_array) const{
+template<class t_bitvector, class t_bwt>
+Interval_pair BD_BWT_index<t_bitvector, t_bwt>::right_extend(Interval_pair intervals, uint8_t c, const std::vector<int64_t>& local_c_array) const{
     assert(local_c_array.size() >= 256);
+    return right_extend_by(intervals, c, local_c_array[c]);
+}
+
+// Right extension when the number of characters smaller than c in the reverse interval is known
+template<class t_bitvector, class t_bwt>
+Interval_pair BD_BWT_index<t_bitvector, t_bwt>::right_extend_by(Interval_pair intervals, uint8_t c, int64_t count_smaller) const{
     if(intervals.forward.size() == 0)
         return Interval_pair(-1,-2,-1,-2);
     
@@ -222,7 +901,7 @@ Interval_pair BD_BWT_index<t_bitvector>::right_extend(Interval_pair intervals, u
     if(start_r_new > end_r_new) return Interval_pair(-1,-2,-1,-2); // num_c_in_interval == 0
     
     // Compute the new forward interval
-    int64_t start_f_new = forward.left + local_c_array[c];
+    int64_t start_f_new = forward.left + count_smaller;
     int64_t end_f_new = start_f_new + (end_r_new - start_r_new); // The forward and reverse intervals must have same length
     
     return Interval_pair(start_f_new,end_f_new,start_r_new,end_r_new);
@@ -231,10 +910,10 @@ Interval_pair BD_BWT_index<t_bitvector>::right_extend(Interval_pair intervals, u
 
 
 // Compute the cumulative sum of character counts in lexicographical order
-// Assumes alphabet is sorted
+// Assumes the alphabet is in the order of the BWT rows, see sorted_alphabet
 // Counts = vector with 256 elements
-template<class t_bitvector>
-void BD_BWT_index<t_bitvector>::count_smaller_chars(const sdsl::wt_huff<t_bitvector>& bwt, 
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::count_smaller_chars(const t_bwt& bwt, 
                                                     std::vector<int64_t>& counts, Interval I) const{
     assert(alphabet.size() != 0);
     counts[alphabet[0]] = 0;
@@ -250,87 +929,397 @@ void BD_BWT_index<t_bitvector>::count_smaller_chars(const sdsl::wt_huff<t_bitvec
     }
 }
 
-template<class t_bitvector>
-bool BD_BWT_index<t_bitvector>::is_right_maximal(Interval_pair I) const{
+// Finds the character at the left end of the interval and its rank there with one descent of the
+// wavelet tree, and counts the character in the interval with one more rank query. The interval
+// has another character iff the count is less than the size of the interval. Enumerating the
+// distinct characters with interval_symbols would take ranks for every one of them.
+template<class t_bitvector, class t_bwt>
+bool BD_BWT_index<t_bitvector, t_bwt>::has_two_distinct_symbols(const t_bwt& wt, Interval I) const{
+    if(I.size() < 2) return false;
+    auto rank_and_symbol = wt.inverse_select(I.left);
+    return (int64_t)(wt.rank(I.right + 1, rank_and_symbol.second) - rank_and_symbol.first) < I.size();
+}
+
+// An interval is right-maximal iff it has more than one possible right extension
+template<class t_bitvector, class t_bwt>
+bool BD_BWT_index<t_bitvector, t_bwt>::is_right_maximal(Interval_pair I) const{
+    return has_two_distinct_symbols(reverse_bwt, I.reverse);
+}
+
+// An interval is left-maximal iff it has more than one possible left extension
+template<class t_bitvector, class t_bwt>
+bool BD_BWT_index<t_bitvector, t_bwt>::is_left_maximal(Interval_pair I) const{
+    return has_two_distinct_symbols(forward_bwt, I.forward);
+}
+
+// Computes the extensions of the string with interval I in the given BWT and interval other in the
+// other BWT. The symbols of interval_symbols are sorted into the order of the BWT rows, after which
+// the intervals of the extensions in the other BWT are consecutive subintervals of other.
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::extensions(const t_bwt& wt, Interval I, Interval other, bool left,
+                                                  BD_BWT_index_extensions& result) const{
+    sdsl::int_vector_size_type k;
+    get_interval_symbols(wt, I, k, result.symbols, result.ranks_i, result.ranks_j);
     
-    // An interval is right-maximal iff it has more than one possible right extension
-    std::vector<uint8_t> symbols = get_interval_symbols(reverse_bwt, I.reverse);
-    return (symbols.size() >= 2);
+    // Insertion sort, because there are few symbols. END comes before all other bytes, including 0x00
+    auto row_order = [](uint8_t c){ return c == END ? -1 : (int)c; };
+    for(int64_t i = 1; i < (int64_t)k; i++){
+        uint8_t c = result.symbols[i];
+        uint64_t rank_i = result.ranks_i[i], rank_j = result.ranks_j[i];
+        int64_t j = i;
+        for(; j > 0 && row_order(result.symbols[j-1]) > row_order(c); j--){
+            result.symbols[j] = result.symbols[j-1];
+            result.ranks_i[j] = result.ranks_i[j-1];
+            result.ranks_j[j] = result.ranks_j[j-1];
+        }
+        result.symbols[j] = c;
+        result.ranks_i[j] = rank_i;
+        result.ranks_j[j] = rank_j;
+    }
+    
+    int64_t other_start = other.left;
+    for(int64_t i = 0; i < (int64_t)k; i++){
+        int64_t count = result.ranks_j[i] - result.ranks_i[i];
+        int64_t start = global_c_array[result.symbols[i]] + result.ranks_i[i];
+        Interval extended(start, start + count - 1);
+        Interval other_extended(other_start, other_start + count - 1);
+        result.intervals[i] = left ? Interval_pair(extended, other_extended) : Interval_pair(other_extended, extended);
+        other_start += count;
+    }
+    result.count = k;
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::left_extensions(Interval_pair intervals, BD_BWT_index_extensions& result) const{
+    extensions(forward_bwt, intervals.forward, intervals.reverse, true, result);
 }
 
-template<class t_bitvector>
-bool BD_BWT_index<t_bitvector>::is_left_maximal(Interval_pair I) const{
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::right_extensions(Interval_pair intervals, BD_BWT_index_extensions& result) const{
+    extensions(reverse_bwt, intervals.reverse, intervals.forward, false, result);
+}
+
+// Builds the node tables of the batched queries from the wavelet trees and the alphabet
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::init_batches(){
+    forward_batch.init(forward_bwt, alphabet);
+    reverse_batch.init(reverse_bwt, alphabet);
+}
+
+// The batch version of extensions. The characters of each interval are sorted into the order of the
+// alphabet by insertion sort, like in extensions.
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::extensions_batch(const Extension_batch<t_bwt>& batch, const t_bwt& wt,
+                                                        const Interval_pair* intervals, int64_t n, bool left,
+                                                        BD_BWT_index_batch_extensions& result) const{
+    Extension_batch_workspace& workspace = Extension_batch_workspace::local();
+    batch.symbols(wt, intervals, left ? &Interval_pair::forward : &Interval_pair::reverse, n, workspace);
+    std::vector<Interval_symbol>& found = workspace.found;
+    auto row_order = [](uint8_t c){ return c == END ? -1 : (int)c; };
+    for(int64_t i = 1; i < (int64_t)found.size(); i++){
+        Interval_symbol x = found[i];
+        int64_t j = i;
+        for(; j > 0 && found[j-1].k == x.k && row_order(found[j-1].symbol) > row_order(x.symbol); j--) found[j] = found[j-1];
+        found[j] = x;
+    }
     
-    // An interval is left-maximal iff it has more than one possible left extension
-    std::vector<uint8_t> symbols = get_interval_symbols(forward_bwt, I.forward);
-    return (symbols.size() >= 2);
+    result.begin.assign(n + 1, 0);
+    result.symbols.resize(found.size());
+    result.intervals.resize(found.size());
+    int64_t i = 0;
+    for(int64_t k = 0; k < n; k++){
+        result.begin[k] = i;
+        int64_t other_start = left ? intervals[k].reverse.left : intervals[k].forward.left;
+        for(; i < (int64_t)found.size() && found[i].k == k; i++){
+            int64_t count = found[i].rank_j - found[i].rank_i;
+            int64_t start = global_c_array[found[i].symbol] + found[i].rank_i;
+            Interval extended(start, start + count - 1);
+            Interval other_extended(other_start, other_start + count - 1);
+            result.symbols[i] = found[i].symbol;
+            result.intervals[i] = left ? Interval_pair(extended, other_extended) : Interval_pair(other_extended, extended);
+            other_start += count;
+        }
+    }
+    result.begin[n] = i;
 }
 
-// Returns the alphabet in sorted order
-template<class t_bitvector>
-std::vector<uint8_t> BD_BWT_index<t_bitvector>::get_string_alphabet(const uint8_t* s) const{
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::left_extensions_batch(const Interval_pair* intervals, int64_t n,
+                                                             BD_BWT_index_batch_extensions& result) const{
+    extensions_batch(forward_batch, forward_bwt, intervals, n, true, result);
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::right_extensions_batch(const Interval_pair* intervals, int64_t n,
+                                                              BD_BWT_index_batch_extensions& result) const{
+    extensions_batch(reverse_batch, reverse_bwt, intervals, n, false, result);
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::is_right_maximal_batch(const Interval_pair* intervals, int64_t n, std::vector<bool>& result) const{
+    result.resize(n);
+    reverse_batch.two_symbols(reverse_bwt, intervals, &Interval_pair::reverse, n, result, Extension_batch_workspace::local());
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::is_left_maximal_batch(const Interval_pair* intervals, int64_t n, std::vector<bool>& result) const{
+    result.resize(n);
+    forward_batch.two_symbols(forward_bwt, intervals, &Interval_pair::forward, n, result, Extension_batch_workspace::local());
+}
+
+// Returns the alphabet of s[0..n-1] in sorted order
+template<class t_bitvector, class t_bwt>
+std::vector<uint8_t> BD_BWT_index<t_bitvector, t_bwt>::get_string_alphabet(const uint8_t* s, int64_t n){
     
     std::vector<bool> found(256,false);
-    while(*s != 0){
-        found[*s] = true;
-        s++;
-    }
+    for(int64_t i = 0; i < n; i++) found[s[i]] = true;
+    return sorted_alphabet(found);
+}
 
+// The characters with found[c] set in the order of the rows of the BWT. END sorts before
+// every other character, also before 0x00, because dbwt places the end of the text first.
+template<class t_bitvector, class t_bwt>
+std::vector<uint8_t> BD_BWT_index<t_bitvector, t_bwt>::sorted_alphabet(const std::vector<bool>& found){
     std::vector<uint8_t> alphabet;
+    if(found[END]) alphabet.push_back(END);
     for(int i = 0; i < 256; i++){
-        if(found[i]) alphabet.push_back((uint8_t)i);
+        if(found[i] && i != END) alphabet.push_back((uint8_t)i);
     }
-    
     return alphabet;
 }
 
 // strlen(const uint8_t*) is not in the standard library
-template<class t_bitvector>
-int64_t BD_BWT_index<t_bitvector>::strlen(const uint8_t* str) const{
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index<t_bitvector, t_bwt>::strlen(const uint8_t* str){
     const uint8_t* start = str;
     while(*str != 0) str++;
     return str - start;
 }
 
-template<class t_bitvector>
-BD_BWT_index<t_bitvector>::BD_BWT_index(const uint8_t* input){
-    if(*input == 0) throw std::runtime_error("Tried to construct BD_BWT_index for an empty string");
-    int64_t n = strlen(input);
+// Seconds elapsed since the given time point
+template<class t_bitvector, class t_bwt>
+double BD_BWT_index<t_bitvector, t_bwt>::seconds_since(std::chrono::steady_clock::time_point start){
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Rough estimate of the memory needed to build one direction: the working copy of the input,
+// the dbwt workspace including its output (about 3.2n bytes on DNA), and later the transform,
+// its temporary file and the wavelet tree. The factor 5 is rounded up from the measured peak
+// of a sequential construction of a random DNA string that copies its input.
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index<t_bitvector, t_bwt>::estimate_construction_peak_bytes(int64_t n, bool parallel){
+    int64_t one_direction = 5*n;
+    return parallel ? 2*one_direction : one_direction;
+}
+
+// Estimate of the peak memory of semi-external construction, not counting the input: the text
+// held in memory by construct_sa_se and the BWT scan, and its recursion and stream buffers.
+// Rounded up from the measured peak on random DNA.
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index<t_bitvector, t_bwt>::estimate_semi_external_peak_bytes(int64_t n){
+    return 2*n + (64 << 20);
+}
+
+// Computes the BWT of text[0..n-1], which is the input or its reverse, and builds the wavelet tree of it.
+// dbwt reads the byte text[n] and only gives the right transform if it is zero.
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::build_direction(uint8_t* text, int64_t n, bool reverse, t_bwt& wt,
+                                                double& bwt_seconds, double& wt_seconds, int64_t& dbwt_peak_bytes){
+    auto start = std::chrono::steady_clock::now();
+    text[n] = 0;
+    uint8_t* transform = bwt_dbwt(text,n,END,&dbwt_peak_bytes);
+    bwt_seconds = seconds_since(start);
+
+    // Same as sdsl::construct_im, but with a temporary file name that is unique per thread.
+    // sdsl::util::id() is not atomic, so two concurrent construct_im calls could collide.
+    start = std::chrono::steady_clock::now();
+    std::stringstream tmp_name;
+    tmp_name << "bd_bwt_" << sdsl::util::pid() << "_" << (const void*)this << (reverse ? "_reverse" : "_forward");
+    std::string tmp_file = sdsl::ram_file_name(tmp_name.str());
+    if(!reverse) this->alphabet = get_string_alphabet(transform, n + 1);
     
-    if(std::find(input, input+n, END) != input + n){
-        std::stringstream error;
-        error << "Input string contains forbidden byte " << std::hex << END;
-        throw std::runtime_error(error.str());
+    // Store the transform, which may contain 0x00, as a RAM file of its final size. Writing it through
+    // a stream would grow the file by doubling, which used to be the memory peak of the whole construction.
+    // The transform is copied in blocks and the whole pages of each copied block are given back at once,
+    // so the copy adds one block to the peak instead of n bytes.
+    sdsl::ram_fs::content_type content;
+    content.reserve(n + 1);
+    const int64_t block_size = 1 << 24;
+    const uintptr_t page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t released = ((uintptr_t)transform + page_size - 1) / page_size * page_size;
+    for(int64_t i = 0; i < n + 1; i += block_size){
+        int64_t end = std::min(n + 1, i + block_size);
+        content.insert(content.end(), transform + i, transform + end);
+        uintptr_t copied = (uintptr_t)(transform + end) / page_size * page_size;
+        if(copied > released){
+            madvise((void*)released, copied - released, MADV_DONTNEED);
+            released = copied;
+        }
     }
+    free(transform);
+    sdsl::ram_fs::store(tmp_file, std::move(content));
+    sdsl::construct(wt, tmp_file, 1);
+    sdsl::ram_fs::remove(tmp_file);
+    wt_seconds = seconds_since(start);
+}
+
+// Same result as build_direction, but the suffix array and the BWT are built on disk.
+// The text is written to disk followed by END and the zero sentinel that construct_sa_se needs.
+// The rotations of text+END sort like the suffixes of text+END+0 without the suffix "0",
+// so the BWT is the BWT of text+END+0 without its first row and with END in place of the sentinel.
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::build_direction_semi_external(const uint8_t* input, int64_t n, bool reverse, t_bwt& wt,
+                                                              const std::string& tmp_dir, double& bwt_seconds, double& wt_seconds){
+    auto start = std::chrono::steady_clock::now();
+    std::stringstream id;
+    id << "bd_bwt_" << sdsl::util::pid() << "_" << (const void*)this << (reverse ? "_reverse" : "_forward");
+    sdsl::cache_config cache(true, tmp_dir, id.str());
+    std::string text_file = sdsl::cache_file_name(sdsl::conf::KEY_TEXT, cache);
+    std::string bwt_file = sdsl::cache_file_name(sdsl::conf::KEY_BWT, cache);
     
-    // Build the two bwts
-    uint8_t* forward = (uint8_t*) malloc(sizeof(uint8_t) * (n + 1));
-    uint8_t* backward = (uint8_t*) malloc(sizeof(uint8_t) * (n + 1));
-    for(int64_t i = 0; i < n; i++){
-        forward[i] = input[i];
-        backward[n-1-i] = input[i];
+    try{
+        {
+            sdsl::int_vector_buffer<8> text(text_file, std::ios::out);
+            if(reverse) for(int64_t i = n-1; i >= 0; i--) text.push_back(input[i]);
+            else for(int64_t i = 0; i < n; i++) text.push_back(input[i]);
+            text.push_back(END);
+            text.push_back(0);
+        }
+        sdsl::register_cache_file(sdsl::conf::KEY_TEXT, cache);
+        sdsl::construct_sa_se(cache);
+        
+        {
+            sdsl::int_vector<8> text;
+            sdsl::load_from_file(text, text_file);
+            sdsl::remove(text_file);
+            sdsl::int_vector_buffer<> sa(sdsl::cache_file_name(sdsl::conf::KEY_SA, cache), std::ios::in);
+            sdsl::int_vector_buffer<8> bwt(bwt_file, std::ios::out);
+            std::vector<bool> found(256,false);
+            for(uint64_t i = 0; i < sa.size(); i++){
+                uint64_t pos = sa[i];
+                if(pos == (uint64_t)n + 1) continue; // The sentinel
+                uint8_t c = (pos == 0) ? END : text[pos-1];
+                found[c] = true;
+                bwt.push_back(c);
+            }
+            if(!reverse) this->alphabet = sorted_alphabet(found);
+        }
+        sdsl::remove(sdsl::cache_file_name(sdsl::conf::KEY_SA, cache));
+        bwt_seconds = seconds_since(start);
+        
+        start = std::chrono::steady_clock::now();
+        {
+            sdsl::int_vector_buffer<8> bwt(bwt_file, std::ios::in);
+            t_bwt tmp(bwt, bwt.size());
+            wt.swap(tmp);
+        }
+        sdsl::remove(bwt_file);
+        wt_seconds = seconds_since(start);
+    } catch(...){
+        for(std::string file : {text_file, sdsl::cache_file_name(sdsl::conf::KEY_SA, cache), bwt_file})
+            if(sdsl::util::file_size(file) > 0) sdsl::remove(file);
+        throw;
     }
-    forward[n] = END;
-    backward[n] = END;
+}
 
-    uint8_t* forward_transform = bwt_dbwt(forward,n,END);
-    free(forward);
-        
-    uint8_t* backward_transform = bwt_dbwt(backward,n,END);
-    free(backward);
+template<class t_bitvector, class t_bwt>
+BD_BWT_index<t_bitvector, t_bwt>::BD_BWT_index(const uint8_t* input, const BD_BWT_index_construction_config& config){
+    construct(input, strlen(input), nullptr, config);
+}
+
+template<class t_bitvector, class t_bwt>
+BD_BWT_index<t_bitvector, t_bwt>::BD_BWT_index(const uint8_t* input, int64_t n, const BD_BWT_index_construction_config& config){
+    construct(input, n, nullptr, config);
+}
+
+template<class t_bitvector, class t_bwt>
+BD_BWT_index<t_bitvector, t_bwt>::BD_BWT_index(std::vector<uint8_t>&& text, const BD_BWT_index_construction_config& config){
+    construct(text.data(), text.size(), &text, config);
+    std::vector<uint8_t>().swap(text);
+}
+
+// Builds the index of input[0..n-1]. If text is not null, it holds the input and may be used as
+// the working copy of dbwt.
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index<t_bitvector, t_bwt>::construct(const uint8_t* input, int64_t n, std::vector<uint8_t>* text,
+                                          const BD_BWT_index_construction_config& config){
+    if(n == 0) throw std::runtime_error("Tried to construct BD_BWT_index for an empty string");
     
-    // Build wavelet trees
-    construct_im(this->forward_bwt, (const char*)forward_transform, 1); // Must cast to signed char* or else breaks. File a bug report to sdsl?
-    construct_im(this->reverse_bwt, (const char*)backward_transform, 1); // Must cast to signed char* or else breaks. File a bug report to sdsl?
+    const uint8_t* forbidden = std::find(input, input+n, END);
+    if(forbidden != input + n){
+        std::stringstream error;
+        error << "Input string contains the forbidden byte 0x" << std::hex << std::setw(2) << std::setfill('0') << (int)END << std::dec
+              << " at position " << (forbidden - input);
+        throw std::runtime_error(error.str());
+    }
     
-    this->alphabet = get_string_alphabet(forward_transform);
+    auto start = std::chrono::steady_clock::now();
+    BD_BWT_index_construction_stats& stats = this->construction_stats;
+    stats.parallel = config.parallel;
+    if(config.parallel && config.max_memory_bytes > 0
+       && estimate_construction_peak_bytes(n,true) > config.max_memory_bytes){
+        stats.parallel = false; // Parallel construction would not fit in the memory budget
+    }
+    // construct_sa_se needs a zero byte as the unique smallest character
+    bool contains_zero = std::find(input, input+n, 0) != input + n;
+    if(config.semi_external && contains_zero)
+        throw std::runtime_error("Semi-external construction does not support inputs containing 0x00 bytes");
+    stats.semi_external = config.semi_external;
+    if(!stats.parallel && config.max_memory_bytes > 0 && !contains_zero
+       && estimate_construction_peak_bytes(n,false) > config.max_memory_bytes){
+        stats.semi_external = true; // Even sequential in-memory construction would not fit in the memory budget
+    }
+    if(stats.semi_external) stats.parallel = false;
+    stats.estimated_peak_bytes = stats.semi_external ? estimate_semi_external_peak_bytes(n)
+                                                     : estimate_construction_peak_bytes(n,stats.parallel);
     
-    free(forward_transform);
-    free(backward_transform); 
+    // Build the two bwts and their wavelet trees
+    if(stats.semi_external){
+        build_direction_semi_external(input, n, false, this->forward_bwt, config.tmp_dir, stats.forward_bwt_seconds, stats.forward_wt_seconds);
+        build_direction_semi_external(input, n, true, this->reverse_bwt, config.tmp_dir, stats.reverse_bwt_seconds, stats.reverse_wt_seconds);
+    } else{
+        // The working copy of the text, with room for the byte that dbwt reads after the end
+        std::vector<uint8_t> copy;
+        if(text == nullptr){
+            copy.reserve(n + 1);
+            copy.assign(input, input + n);
+            text = &copy;
+        }
+        text->push_back(0);
+        
+        if(stats.parallel){
+            std::vector<uint8_t> reversed(n + 1);
+            std::reverse_copy(text->begin(), text->begin() + n, reversed.begin());
+            std::exception_ptr reverse_error = nullptr;
+            std::thread reverse_thread([&](){
+                try{
+                    build_direction(reversed.data(), n, true, this->reverse_bwt, stats.reverse_bwt_seconds, stats.reverse_wt_seconds, stats.reverse_dbwt_peak_bytes);
+                } catch(...){
+                    reverse_error = std::current_exception();
+                }
+            });
+            try{
+                build_direction(text->data(), n, false, this->forward_bwt, stats.forward_bwt_seconds, stats.forward_wt_seconds, stats.forward_dbwt_peak_bytes);
+            } catch(...){
+                reverse_thread.join();
+                throw;
+            }
+            reverse_thread.join();
+            if(reverse_error) std::rethrow_exception(reverse_error);
+        } else{
+            build_direction(text->data(), n, false, this->forward_bwt, stats.forward_bwt_seconds, stats.forward_wt_seconds, stats.forward_dbwt_peak_bytes);
+            std::reverse(text->begin(), text->begin() + n);
+            build_direction(text->data(), n, true, this->reverse_bwt, stats.reverse_bwt_seconds, stats.reverse_wt_seconds, stats.reverse_dbwt_peak_bytes);
+        }
+    }
     
     // Compute cumulative character counts
     this->global_c_array.resize(256);
     count_smaller_chars(forward_bwt,global_c_array,Interval(0,forward_bwt.size()-1));
+    init_batches();
+    
+    stats.total_seconds = seconds_since(start);
+    if(config.print_timings) stats.print(std::cerr);
 }
 
 #endif
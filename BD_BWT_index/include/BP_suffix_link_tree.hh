@@ -0,0 +1,173 @@
+#ifndef BP_SUFFIX_LINK_TREE_HH
+#define BP_SUFFIX_LINK_TREE_HH
+
+#include <sdsl/bit_vectors.hpp>
+#include <sdsl/bp_support.hpp>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <fstream>
+#include <stdexcept>
+#include <cstring>
+
+/*
+ * The topology of a suffix link tree as balanced parentheses, with the label of the edge from the
+ * parent of every node, written by slt_to_dot --bp. Takes 2 bits per node for the parentheses and
+ * one byte per node for the labels, plus the navigation structures of bp_support_sada.
+ *
+ * The nodes are numbered in preorder starting from the root, which is node 0. The children of a
+ * node are in the order in which BD_BWT_index_iterator visits them, i.e. in decreasing order of
+ * their labels, or in the order of their interval sizes with slt_to_dot --smallest-first. The label
+ * of the root is 0.
+ */
+class BP_suffix_link_tree{
+
+private:
+    sdsl::bit_vector bp;
+    sdsl::bp_support_sada<> bp_support;
+    sdsl::int_vector<8> labels; // In preorder
+
+    static const char* magic() { return "SLTBPTRE"; }
+    enum { VERSION = 1 };
+
+    int64_t position(int64_t v) const { return bp_support.select(v+1); } // Of the opening parenthesis
+    int64_t node_at(int64_t pos) const { return bp_support.rank(pos) - 1; }
+
+public:
+
+    /*
+     * Builds the tree from the nodes in preorder. Give every node to add_node with its depth
+     * and the label of the edge from its parent.
+     */
+    class Builder{
+    private:
+        sdsl::bit_vector bp;
+        sdsl::int_vector<8> labels;
+        int64_t bits;
+        int64_t nodes;
+        int64_t open; // Number of nodes whose closing parenthesis has not been written yet
+
+        void append(bool bit){
+            if(bits == (int64_t)bp.size()) bp.resize(std::max((int64_t)64, 2 * bits));
+            bp[bits++] = bit;
+        }
+
+    public:
+        Builder() : bits(0), nodes(0), open(0) {}
+
+        void add_node(int64_t depth, uint8_t label){
+            if(depth > open || (nodes > 0 && depth == 0) || (nodes == 0 && depth != 0))
+                throw std::runtime_error("BP_suffix_link_tree: the nodes must be added in preorder");
+            while(open > depth){
+                append(0);
+                open--;
+            }
+            append(1);
+            open++;
+            if(nodes == (int64_t)labels.size()) labels.resize(std::max((int64_t)64, 2 * nodes));
+            labels[nodes++] = label;
+        }
+
+        // Closes the open nodes and moves the tree into result. The builder is empty afterwards.
+        void finish(BP_suffix_link_tree& result){
+            while(open > 0){
+                append(0);
+                open--;
+            }
+            bp.resize(bits);
+            labels.resize(nodes);
+            result.bp.swap(bp);
+            result.labels.swap(labels);
+            result.bp_support = sdsl::bp_support_sada<>(&result.bp);
+            bits = nodes = 0;
+        }
+    };
+
+    BP_suffix_link_tree() {}
+
+    BP_suffix_link_tree(const BP_suffix_link_tree&) = delete;
+    BP_suffix_link_tree& operator=(const BP_suffix_link_tree&) = delete;
+
+    int64_t size() const { return labels.size(); } // Number of nodes
+
+    uint8_t label(int64_t v) const { return labels[v]; }
+
+    // Returns -1 for the root
+    int64_t parent(int64_t v) const{
+        if(v == 0) return -1;
+        return node_at(bp_support.enclose(position(v)));
+    }
+
+    int64_t depth(int64_t v) const { return bp_support.excess(position(v)) - 1; }
+
+    // Number of nodes in the subtree of v, including v
+    int64_t subtree_size(int64_t v) const{
+        int64_t pos = position(v);
+        return (bp_support.find_close(pos) - pos + 1) / 2;
+    }
+
+    // Returns -1 if v is a leaf
+    int64_t first_child(int64_t v) const{
+        int64_t pos = position(v);
+        return bp[pos+1] ? v + 1 : -1;
+    }
+
+    // Returns -1 if v is the last child of its parent
+    int64_t next_sibling(int64_t v) const{
+        int64_t close = bp_support.find_close(position(v));
+        return close + 1 < (int64_t)bp.size() && bp[close+1] ? v + subtree_size(v) : -1;
+    }
+
+    std::vector<int64_t> children(int64_t v) const{
+        std::vector<int64_t> result;
+        for(int64_t c = first_child(v); c != -1; c = next_sibling(c)) result.push_back(c);
+        return result;
+    }
+
+    // The string of the node: the labels on the path from the node up to the root
+    std::string node_string(int64_t v) const{
+        std::string s;
+        for(; v > 0; v = parent(v)) s.push_back(labels[v]);
+        return s;
+    }
+
+    int64_t serialize(std::ostream& out) const{
+        out.write(magic(), 8);
+        uint32_t version = VERSION;
+        out.write((const char*)&version, sizeof(version));
+        int64_t written = 8 + sizeof(version);
+        written += bp.serialize(out);
+        written += bp_support.serialize(out);
+        written += labels.serialize(out);
+        if(!out) throw std::runtime_error("Failed to write BP_suffix_link_tree");
+        return written;
+    }
+
+    // Throws std::runtime_error if the stream does not contain a tree written by serialize
+    void load(std::istream& in){
+        char file_magic[8];
+        uint32_t version = 0;
+        in.read(file_magic, 8);
+        in.read((char*)&version, sizeof(version));
+        if(!in || std::memcmp(file_magic, magic(), 8) != 0) throw std::runtime_error("Not a BP_suffix_link_tree file");
+        if(version != VERSION) throw std::runtime_error("Unsupported BP_suffix_link_tree format version");
+        bp.load(in);
+        bp_support.load(in, &bp);
+        labels.load(in);
+        if(!in || bp.size() != 2 * labels.size()) throw std::runtime_error("Truncated or corrupted BP_suffix_link_tree");
+    }
+
+    void store_to_file(const std::string& filename) const{
+        std::ofstream out(filename, std::ios::binary);
+        if(!out) throw std::runtime_error("Failed to open " + filename);
+        serialize(out);
+    }
+
+    void load_from_file(const std::string& filename){
+        std::ifstream in(filename, std::ios::binary);
+        if(!in) throw std::runtime_error("Failed to open " + filename);
+        load(in);
+    }
+};
+
+#endif
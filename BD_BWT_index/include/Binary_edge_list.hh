@@ -0,0 +1,132 @@
+#ifndef BINARY_EDGE_LIST_HH
+#define BINARY_EDGE_LIST_HH
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * The binary edge list format of the suffix link tree, written by slt_to_dot --binary.
+ *
+ * The file starts with a Binary_edge_list_header, followed by one record per edge in the order
+ * of the dot output. The child of the i-th edge (counting from zero) is always node i+1 and the
+ * root is node 0, so a record stores only the difference between the child and the parent as an
+ * unsigned LEB128 varint, followed by the label byte. Most records take two or three bytes.
+ */
+class Binary_edge_list_header{
+public:
+    char magic[8]; // "SLTEDGES"
+    uint32_t version;
+    uint32_t alphabet_size; // Number of distinct edge labels that the text can produce
+    uint64_t nodes;
+    uint64_t edges;
+    uint64_t data_bytes; // Bytes of edge records after the header
+    uint8_t alphabet[256]; // The labels in increasing order in [0..alphabet_size)
+
+    enum { VERSION = 1 };
+    static const char* expected_magic() { return "SLTEDGES"; }
+};
+
+static_assert(sizeof(Binary_edge_list_header) == 296, "Binary_edge_list_header must have no padding");
+
+/*
+ * Reads a binary edge list in place from a memory mapping. Throws std::runtime_error if the file
+ * can not be read or is not a binary edge list of the supported version.
+ */
+class Binary_edge_list{
+
+private:
+    int fd;
+    const uint8_t* data; // The whole file
+    size_t size;
+
+    const uint8_t* records() const { return data + sizeof(Binary_edge_list_header); }
+
+public:
+    explicit Binary_edge_list(const std::string& filename) : fd(-1), data(nullptr), size(0){
+        fd = ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0) throw std::runtime_error("Failed to open " + filename + ": " + std::strerror(errno));
+        struct stat st;
+        if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(Binary_edge_list_header)){
+            ::close(fd);
+            throw std::runtime_error(filename + " is not a binary edge list");
+        }
+        size = st.st_size;
+        void* mapping = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(mapping == MAP_FAILED){
+            ::close(fd);
+            throw std::runtime_error("Failed to map " + filename + ": " + std::strerror(errno));
+        }
+        data = (const uint8_t*)mapping;
+        madvise(mapping, size, MADV_SEQUENTIAL);
+        const Binary_edge_list_header& h = header();
+        std::string error;
+        if(std::memcmp(h.magic, Binary_edge_list_header::expected_magic(), 8) != 0) error = " is not a binary edge list";
+        else if(h.version != Binary_edge_list_header::VERSION) error = " has an unsupported binary edge list version";
+        else if(h.data_bytes != size - sizeof(Binary_edge_list_header) || h.nodes != h.edges + 1 || h.alphabet_size > 256)
+            error = " is truncated or corrupted";
+        if(error != ""){
+            ::munmap((void*)data, size);
+            ::close(fd);
+            throw std::runtime_error(filename + error);
+        }
+    }
+
+    Binary_edge_list(const Binary_edge_list&) = delete;
+    Binary_edge_list& operator=(const Binary_edge_list&) = delete;
+
+    ~Binary_edge_list(){
+        ::munmap((void*)data, size);
+        ::close(fd);
+    }
+
+    const Binary_edge_list_header& header() const { return *(const Binary_edge_list_header*)data; }
+    int64_t nodes() const { return header().nodes; }
+    int64_t edges() const { return header().edges; }
+    std::vector<uint8_t> alphabet() const { return std::vector<uint8_t>(header().alphabet, header().alphabet + header().alphabet_size); }
+
+    // Calls f(parent, child, label) for every edge in order
+    template<class F> void for_each_edge(F f) const{
+        const uint8_t* p = records();
+        const uint8_t* end = data + size;
+        int64_t n_edges = edges();
+        for(int64_t child = 1; child <= n_edges; child++){
+            uint64_t delta = 0;
+            int shift = 0;
+            while(true){
+                if(p == end || shift > 63) throw std::runtime_error("Corrupted binary edge list");
+                uint8_t byte = *p++;
+                delta |= (uint64_t)(byte & 0x7F) << shift;
+                shift += 7;
+                if(byte < 0x80) break;
+            }
+            if(p == end || delta == 0 || (int64_t)delta > child) throw std::runtime_error("Corrupted binary edge list");
+            f(child - (int64_t)delta, child, *p++);
+        }
+    }
+
+    // Builds the children of every node in compressed sparse row form: the children of node v are
+    // children[offsets[v]..offsets[v+1]) in the order of the edges, with the edge labels in labels
+    void build_csr(std::vector<int64_t>& offsets, std::vector<int64_t>& children, std::vector<uint8_t>& labels) const{
+        offsets.assign(nodes() + 1, 0);
+        for_each_edge([&offsets](int64_t parent, int64_t child, uint8_t c){ offsets[parent+1]++; });
+        for(int64_t v = 0; v < nodes(); v++) offsets[v+1] += offsets[v];
+        children.resize(edges());
+        labels.resize(edges());
+        std::vector<int64_t> next(offsets.begin(), offsets.end() - 1);
+        for_each_edge([&](int64_t parent, int64_t child, uint8_t c){
+            int64_t i = next[parent]++;
+            children[i] = child;
+            labels[i] = c;
+        });
+    }
+};
+
+#endif
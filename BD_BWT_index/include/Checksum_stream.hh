@@ -0,0 +1,97 @@
+#ifndef CHECKSUM_STREAM_HH
+#define CHECKSUM_STREAM_HH
+
+#include <streambuf>
+#include <cstdint>
+
+/*
+ * Stream buffers that pass all bytes through to another stream buffer and compute
+ * the 64-bit FNV-1a hash of them on the way. Used to checksum serialized indexes
+ * without holding a second copy of the data in memory.
+ *
+ * The buffers do no buffering of their own, so a reader never consumes bytes past the
+ * ones that were actually requested, and the underlying stream can be used directly
+ * again after the checksummed section.
+ */
+
+class FNV1a_hash{
+public:
+    uint64_t value;
+    FNV1a_hash() : value(14695981039346656037ULL) {}
+    void update(const char* data, int64_t n){
+        uint64_t h = value;
+        for(int64_t i = 0; i < n; i++){
+            h ^= (uint8_t)data[i];
+            h *= 1099511628211ULL;
+        }
+        value = h;
+    }
+};
+
+class Checksum_ostreambuf : public std::streambuf{
+
+private:
+    std::streambuf* sink;
+    FNV1a_hash hash;
+
+public:
+    Checksum_ostreambuf(std::streambuf* sink) : sink(sink) {}
+    uint64_t checksum() const { return hash.value; }
+
+protected:
+    int_type overflow(int_type c){
+        if(traits_type::eq_int_type(c, traits_type::eof())) return traits_type::not_eof(c);
+        char ch = traits_type::to_char_type(c);
+        hash.update(&ch, 1);
+        return sink->sputc(ch);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n){
+        std::streamsize written = sink->sputn(s, n);
+        hash.update(s, written);
+        return written;
+    }
+
+    int sync(){
+        return sink->pubsync();
+    }
+    
+    // Only reports the current position of the sink, so that writers can align their data
+    pos_type seekoff(off_type off, std::ios_base::seekdir dir, std::ios_base::openmode which){
+        if(off != 0 || dir != std::ios_base::cur) return pos_type(off_type(-1));
+        return sink->pubseekoff(0, dir, which);
+    }
+};
+
+class Checksum_istreambuf : public std::streambuf{
+
+private:
+    std::streambuf* source;
+    FNV1a_hash hash;
+
+public:
+    Checksum_istreambuf(std::streambuf* source) : source(source) {}
+    uint64_t checksum() const { return hash.value; }
+
+protected:
+    int_type underflow(){
+        return source->sgetc(); // Peek only: the byte is hashed when it is consumed
+    }
+
+    int_type uflow(){
+        int_type c = source->sbumpc();
+        if(!traits_type::eq_int_type(c, traits_type::eof())){
+            char ch = traits_type::to_char_type(c);
+            hash.update(&ch, 1);
+        }
+        return c;
+    }
+
+    std::streamsize xsgetn(char* s, std::streamsize n){
+        std::streamsize got = source->sgetn(s, n);
+        hash.update(s, got);
+        return got;
+    }
+};
+
+#endif
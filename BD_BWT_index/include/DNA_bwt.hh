@@ -0,0 +1,231 @@
+#ifndef DNA_BWT_HH
+#define DNA_BWT_HH
+
+#include <sdsl/int_vector.hpp>
+#include <sdsl/int_vector_buffer.hpp>
+#include <sdsl/sdsl_concepts.hpp>
+#include <sdsl/util.hpp>
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <cstring>
+#include <utility>
+
+/*
+ * A BWT over an alphabet of at most 8 distinct characters, such as nucleotides with N, the $
+ * separators and END. Can be used in place of the wavelet trees of BD_BWT_index: it has the
+ * access, rank, inverse_select and interval_symbols queries of an sdsl wavelet tree and can be constructed
+ * with sdsl::construct.
+ *
+ * Every character is stored as a 3-bit code split into three bit planes. A block of 128
+ * characters takes one 64-byte cache line: two words of each plane, and the number of
+ * occurrences of every code before the block as 16-bit counts relative to a superblock of
+ * 65536 characters. A rank query reads the superblock count of its character and the cache
+ * line of its block, and the ranks of all characters at the same position read the same line.
+ * The blocks are kept aligned to cache lines inside a buffer that has room for the alignment.
+ */
+class DNA_bwt{
+
+public:
+    typedef uint64_t size_type;
+    typedef uint8_t value_type;
+    typedef sdsl::wt_tag index_category;
+    typedef sdsl::byte_alphabet_tag alphabet_category;
+
+    enum { MAX_SIGMA = 8 };
+    enum { BLOCK_SIZE = 128 }; // Characters per block
+    enum { BLOCK_WORDS = 8 }; // Six plane words and two words of counts
+    enum { SUPERBLOCK_SIZE = 65536 }; // Characters per superblock
+
+    size_type sigma; // Number of distinct characters
+
+private:
+    size_type m_size;
+    size_type m_block_words; // BLOCK_WORDS per block
+    sdsl::int_vector<64> m_blocks; // The blocks start at word m_block_offset
+    size_type m_block_offset;
+    sdsl::int_vector<64> m_superblock_counts; // MAX_SIGMA counts per superblock
+    std::vector<uint8_t> m_char_to_code; // 256 entries, MAX_SIGMA for characters that do not occur
+    std::vector<uint8_t> m_code_to_char;
+
+    // Moves the blocks from the given word offset of the buffer to the first cache-line boundary
+    void align_blocks(size_type old_offset){
+        uintptr_t address = (uintptr_t)m_blocks.data();
+        m_block_offset = ((64 - address % 64) % 64) / sizeof(uint64_t);
+        if(m_block_offset != old_offset)
+            std::memmove(m_blocks.data() + m_block_offset, m_blocks.data() + old_offset, m_block_words * sizeof(uint64_t));
+    }
+
+    // Allocates zeroed blocks
+    void allocate_blocks(size_type words){
+        m_block_words = words;
+        m_blocks = sdsl::int_vector<64>(words + BLOCK_WORDS - 1, 0);
+        align_blocks(0);
+    }
+
+    const uint64_t* blocks() const { return m_blocks.data() + m_block_offset; }
+
+    // Bits of the block word at offset h (0 or 1) that hold the given code
+    static uint64_t code_mask(const uint64_t* block, size_type h, uint8_t code){
+        uint64_t p0 = block[3*h], p1 = block[3*h+1], p2 = block[3*h+2];
+        return ((code & 1) ? p0 : ~p0) & ((code & 2) ? p1 : ~p1) & ((code & 4) ? p2 : ~p2);
+    }
+
+    // Occurrences of the code in positions [0..i) of the BWT
+    size_type rank_code(size_type i, uint8_t code) const{
+        const uint64_t* block = blocks() + (i / BLOCK_SIZE) * BLOCK_WORDS;
+        size_type offset = i % BLOCK_SIZE;
+        size_type result = m_superblock_counts[(i / SUPERBLOCK_SIZE) * MAX_SIGMA + code];
+        result += (block[6 + code/4] >> (16 * (code % 4))) & 0xFFFF;
+        if(offset >= 64){
+            result += sdsl::bits::cnt(code_mask(block, 0, code));
+            offset -= 64;
+            if(offset > 0) result += sdsl::bits::cnt(code_mask(block, 1, code) & sdsl::bits::lo_set[offset]);
+        } else if(offset > 0) result += sdsl::bits::cnt(code_mask(block, 0, code) & sdsl::bits::lo_set[offset]);
+        return result;
+    }
+
+public:
+    DNA_bwt() : sigma(0), m_size(0), m_block_words(0), m_block_offset(0), m_char_to_code(256, MAX_SIGMA) {}
+    DNA_bwt(const DNA_bwt& other) : sigma(other.sigma), m_size(other.m_size), m_block_words(other.m_block_words),
+        m_blocks(other.m_blocks), m_block_offset(other.m_block_offset), m_superblock_counts(other.m_superblock_counts),
+        m_char_to_code(other.m_char_to_code), m_code_to_char(other.m_code_to_char){
+        align_blocks(other.m_block_offset); // The copy of the buffer may have a different alignment
+    }
+    DNA_bwt(DNA_bwt&&) = default;
+    DNA_bwt& operator=(DNA_bwt&&) = default;
+    DNA_bwt& operator=(const DNA_bwt& other){
+        DNA_bwt copy(other);
+        swap(copy);
+        return *this;
+    }
+
+    // Throws std::runtime_error if the input has more than MAX_SIGMA distinct characters
+    DNA_bwt(sdsl::int_vector_buffer<8>& input, size_type size) : sigma(0), m_size(size), m_block_words(0), m_block_offset(0),
+                                                                 m_char_to_code(256, MAX_SIGMA){
+        std::vector<bool> found(256, false);
+        for(size_type i = 0; i < size; i++) found[input[i]] = true;
+        for(int c = 0; c < 256; c++){
+            if(!found[c]) continue;
+            if(m_code_to_char.size() == MAX_SIGMA)
+                throw std::runtime_error("DNA_bwt supports at most 8 distinct characters");
+            m_char_to_code[c] = m_code_to_char.size();
+            m_code_to_char.push_back((uint8_t)c);
+        }
+        sigma = m_code_to_char.size();
+
+        // One extra block and superblock so that rank(size(), c) needs no special case
+        allocate_blocks((size / BLOCK_SIZE + 1) * BLOCK_WORDS);
+        m_superblock_counts = sdsl::int_vector<64>((size / SUPERBLOCK_SIZE + 1) * MAX_SIGMA, 0);
+        std::vector<size_type> counts(MAX_SIGMA, 0); // Occurrences before the current position
+        std::vector<size_type> superblock_counts(MAX_SIGMA, 0);
+        for(size_type i = 0; i <= size; i++){
+            if(i % SUPERBLOCK_SIZE == 0){
+                for(size_type code = 0; code < MAX_SIGMA; code++)
+                    m_superblock_counts[(i / SUPERBLOCK_SIZE) * MAX_SIGMA + code] = superblock_counts[code] = counts[code];
+            }
+            uint64_t* block = m_blocks.data() + m_block_offset + (i / BLOCK_SIZE) * BLOCK_WORDS;
+            if(i % BLOCK_SIZE == 0){
+                for(size_type code = 0; code < MAX_SIGMA; code++)
+                    block[6 + code/4] |= (uint64_t)(counts[code] - superblock_counts[code]) << (16 * (code % 4));
+            }
+            if(i == size) break;
+            uint8_t code = m_char_to_code[input[i]];
+            size_type h = (i % BLOCK_SIZE) / 64, bit = i % 64;
+            for(size_type p = 0; p < 3; p++)
+                block[3*h + p] |= (uint64_t)((code >> p) & 1) << bit;
+            counts[code]++;
+        }
+    }
+
+    size_type size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+    value_type operator[](size_type i) const{
+        const uint64_t* block = blocks() + (i / BLOCK_SIZE) * BLOCK_WORDS;
+        size_type h = (i % BLOCK_SIZE) / 64, bit = i % 64;
+        uint8_t code = ((block[3*h] >> bit) & 1) | (((block[3*h+1] >> bit) & 1) << 1) | (((block[3*h+2] >> bit) & 1) << 2);
+        return m_code_to_char[code];
+    }
+
+    // The rank of the character at position i in [0..i) and the character, like sdsl's wt_pc::inverse_select
+    std::pair<size_type, value_type> inverse_select(size_type i) const{
+        value_type c = (*this)[i];
+        return std::make_pair(rank_code(i, m_char_to_code[c]), c);
+    }
+
+    // Starts loading the memory that a rank query at position i reads into the cache
+    void prefetch(size_type i) const{
+        __builtin_prefetch(blocks() + (i / BLOCK_SIZE) * BLOCK_WORDS);
+        __builtin_prefetch(m_superblock_counts.data() + (i / SUPERBLOCK_SIZE) * MAX_SIGMA);
+    }
+
+    // Number of occurrences of c in positions [0..i)
+    size_type rank(size_type i, value_type c) const{
+        uint8_t code = m_char_to_code[c];
+        if(code == MAX_SIGMA) return 0;
+        return rank_code(i, code);
+    }
+
+    // Stores the k distinct characters of positions [i..j) into cs[0..k) and their ranks at i and j into
+    // rank_c_i and rank_c_j, in the same way as sdsl's wt_pc::interval_symbols. The vectors must have
+    // at least sigma elements. The characters are in increasing order.
+    void interval_symbols(size_type i, size_type j, size_type& k, std::vector<value_type>& cs,
+                          std::vector<size_type>& rank_c_i, std::vector<size_type>& rank_c_j) const{
+        k = 0;
+        if(i >= j) return;
+        for(size_type code = 0; code < sigma; code++){
+            size_type rank_j = rank_code(j, code);
+            if(rank_j == 0) continue;
+            size_type rank_i = rank_code(i, code);
+            if(rank_j > rank_i){
+                cs[k] = m_code_to_char[code];
+                rank_c_i[k] = rank_i;
+                rank_c_j[k] = rank_j;
+                k++;
+            }
+        }
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="") const{
+        sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += sdsl::write_member(m_size, out, child, "size");
+        written_bytes += sdsl::write_member(sigma, out, child, "sigma");
+        out.write((const char*)m_code_to_char.data(), sigma);
+        written_bytes += sigma;
+        written_bytes += sdsl::write_member(m_block_words, out, child, "block_words");
+        out.write((const char*)blocks(), m_block_words * sizeof(uint64_t));
+        written_bytes += m_block_words * sizeof(uint64_t);
+        written_bytes += m_superblock_counts.serialize(out, child, "superblock_counts");
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in){
+        sdsl::read_member(m_size, in);
+        sdsl::read_member(sigma, in);
+        if(sigma > MAX_SIGMA) throw std::runtime_error("Corrupted DNA_bwt: too many characters");
+        m_code_to_char.resize(sigma);
+        in.read((char*)m_code_to_char.data(), sigma);
+        m_char_to_code.assign(256, MAX_SIGMA);
+        for(size_type code = 0; code < sigma; code++) m_char_to_code[m_code_to_char[code]] = code;
+        sdsl::read_member(m_block_words, in);
+        allocate_blocks(m_block_words);
+        in.read((char*)(m_blocks.data() + m_block_offset), m_block_words * sizeof(uint64_t));
+        m_superblock_counts.load(in);
+    }
+
+    void swap(DNA_bwt& other){
+        std::swap(sigma, other.sigma);
+        std::swap(m_size, other.m_size);
+        std::swap(m_block_words, other.m_block_words);
+        m_blocks.swap(other.m_blocks);
+        std::swap(m_block_offset, other.m_block_offset);
+        m_superblock_counts.swap(other.m_superblock_counts);
+        m_char_to_code.swap(other.m_char_to_code);
+        m_code_to_char.swap(other.m_code_to_char);
+    }
+};
+
+#endif
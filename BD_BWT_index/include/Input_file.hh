@@ -0,0 +1,109 @@
+#ifndef INPUT_FILE_HH
+#define INPUT_FILE_HH
+
+#include <vector>
+#include <string>
+#include <stdexcept>
+#include <algorithm>
+#include <utility>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * The bytes of an input file in memory without copies through streams. A regular file is mapped
+ * read-only. Other files, like a pipe or the standard input given as "-", are read in blocks of 16 MB
+ * that are joined into one buffer with one spare byte of capacity, so that the buffer can be
+ * released to the in-place constructor of BD_BWT_index. Each block is freed as soon as it is copied,
+ * so the peak memory is the size of the input and one block. Throws std::runtime_error if the file
+ * can not be opened or read.
+ */
+class Input_file{
+
+private:
+    void* mapping;
+    size_t mapped_size;
+    std::vector<uint8_t> buffer;
+
+    static int64_t read_fully(int fd, uint8_t* out, int64_t n){
+        int64_t used = 0;
+        while(used < n){
+            ssize_t got = ::read(fd, out + used, n - used);
+            if(got == 0) break;
+            if(got < 0){
+                if(errno == EINTR) continue;
+                throw std::runtime_error(std::string("Failed to read the input: ") + std::strerror(errno));
+            }
+            used += got;
+        }
+        return used;
+    }
+
+    void read_blocks(int fd){
+        const int64_t block_size = 1 << 24;
+        std::vector<std::vector<uint8_t>> blocks;
+        int64_t total = 0;
+        while(true){
+            blocks.emplace_back(block_size);
+            int64_t got = read_fully(fd, blocks.back().data(), block_size);
+            blocks.back().resize(got);
+            total += got;
+            if(got < block_size) break;
+        }
+        buffer.reserve(total + 1);
+        for(std::vector<uint8_t>& block : blocks){
+            buffer.insert(buffer.end(), block.begin(), block.end());
+            std::vector<uint8_t>().swap(block);
+        }
+    }
+
+public:
+    const uint8_t* data;
+    int64_t size;
+
+    explicit Input_file(const std::string& filename) : mapping(MAP_FAILED), mapped_size(0), data(nullptr), size(0){
+        bool standard_input = filename == "-";
+        int fd = standard_input ? STDIN_FILENO : ::open(filename.c_str(), O_RDONLY);
+        if(fd < 0) throw std::runtime_error("Failed to open " + filename + ": " + std::strerror(errno));
+        struct stat st;
+        if(fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0){
+            mapping = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(mapping != MAP_FAILED){
+                mapped_size = st.st_size;
+                madvise(mapping, mapped_size, MADV_SEQUENTIAL);
+            }
+        }
+        try{
+            if(mapping == MAP_FAILED) read_blocks(fd);
+        } catch(std::runtime_error& e){
+            if(!standard_input) ::close(fd);
+            throw;
+        }
+        if(!standard_input) ::close(fd); // The mapping stays valid
+        data = mapping != MAP_FAILED ? (const uint8_t*)mapping : buffer.data();
+        size = mapping != MAP_FAILED ? mapped_size : buffer.size();
+    }
+
+    Input_file(const Input_file&) = delete;
+    Input_file& operator=(const Input_file&) = delete;
+
+    ~Input_file(){
+        if(mapping != MAP_FAILED) ::munmap(mapping, mapped_size);
+    }
+
+    bool mapped() const { return mapping != MAP_FAILED; }
+
+    // The bytes of a file that is not mapped, with one spare byte of capacity. Leaves the file empty.
+    std::vector<uint8_t> release(){
+        if(mapped()) throw std::runtime_error("Input_file::release: the file is mapped");
+        data = nullptr;
+        size = 0;
+        return std::move(buffer);
+    }
+};
+
+#endif
@@ -2,15 +2,25 @@
 #define ITERATORS_HH
 
 #include "BD_BWT_index.hh"
+#include "Output_buffer.hh"
+#include "Suffix_link_tree_pruning.hh"
 #include <algorithm>
+#include <memory>
 
 /**
  * Class BD_BWT_index_iterator
  * 
  * Iterates the suffix link tree of the given index.
+ * Prints the edges in .dot format into the given output buffer, or into std::cout if none is given.
+ * The buffer is flushed when the iteration ends.
+ * 
+ * With smallest_first, the children of every node are visited in increasing order of their interval
+ * sizes, which bounds the size of iteration_stack to O(sigma log n) frames. See traverse_suffix_link_tree.
+ * 
+ * The rules of pruning cut the tree like in traverse_suffix_link_tree.
  * 
  */
-template<class t_bitvector>
+template<class t_bitvector, class t_bwt = sdsl::wt_huff<t_bitvector>>
 class BD_BWT_index_iterator{
     
 public:
@@ -25,10 +35,14 @@ public:
         Stack_frame(){}
     };
     
-    const BD_BWT_index<t_bitvector>* index;
+    const BD_BWT_index<t_bitvector, t_bwt>* index;
     bool debug_mode;
     bool stop_at_dollars;
-    int next_id;
+    bool print_edges; // If false, only iterates the nodes
+    bool smallest_first; // Visit the children with the smallest intervals first
+    Suffix_link_tree_pruning pruning;
+    int64_t next_id;
+    Output_buffer* output;
     
     // Iteration state
     std::deque<Stack_frame> iteration_stack;
@@ -36,9 +50,15 @@ public:
     std::string label; // The string on the path from the root to the current node
     
     // Reused space between iterations
-    std::vector<int64_t> local_c_array;
+    BD_BWT_index_extensions children; // Left extensions of the current node
+    std::unique_ptr<Output_buffer> cout_output; // Used if no output buffer is given
     
-    BD_BWT_index_iterator(const BD_BWT_index<t_bitvector>* index, bool debug_mode = false) : index(index), debug_mode(debug_mode), stop_at_dollars(false), next_id(1), local_c_array(256) {
+    BD_BWT_index_iterator(const BD_BWT_index<t_bitvector, t_bwt>* index, bool debug_mode = false, Output_buffer* output = nullptr)
+        : index(index), debug_mode(debug_mode), stop_at_dollars(false), print_edges(true), smallest_first(false), next_id(1), output(output) {
+        if(output == nullptr){
+            cout_output.reset(new Output_buffer(std::cout));
+            this->output = cout_output.get();
+        }
         Interval empty_string(0,index->size()-1);
         iteration_stack.push_back(Stack_frame(Interval_pair(empty_string,empty_string), 0, 0, 0));
         current = iteration_stack.back();
@@ -65,65 +85,80 @@ public:
     
 private:
     void push_right_maximal_children(Stack_frame f);
+    
+    // With stop_at_dollars, the nodes below an edge labelled with a dollar are visited but not expanded
+    bool is_dollar_leaf(const Stack_frame& f) const { return stop_at_dollars && f.depth > 0 && f.extension == '$'; }
+    bool expands(const Stack_frame& f) const { return !is_dollar_leaf(f) && pruning.expands(f.depth, f.extension); }
     void update_label(Stack_frame f);
 };
 
 
-//  Interval_pair left_extend(Interval_pair intervals, char c, const std::vector<int64_t>& local_c_array) const;
-template<class t_bitvector>
-void BD_BWT_index_iterator<t_bitvector>::push_right_maximal_children(Stack_frame f){
-    index->compute_local_c_array_forward(f.intervals.forward, local_c_array);
-    for(uint8_t c : index->get_alphabet()){
-        if(c == BD_BWT_index<t_bitvector>::END) continue;
-        Interval_pair child = index->left_extend(f.intervals,c,local_c_array);
-        if(child.forward.size() == 0) continue; // Extension not possible
-        if(index->is_right_maximal(child)){
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_iterator<t_bitvector, t_bwt>::push_right_maximal_children(Stack_frame f){
+    int64_t first_child = iteration_stack.size();
+    index->left_extensions(f.intervals, children);
+    for(int64_t i = 0; i < children.count; i++){ // In the order of the alphabet
+        uint8_t c = children.symbols[i];
+        if(c == BD_BWT_index<t_bitvector, t_bwt>::END) continue;
+        Interval_pair child = children.intervals[i];
+        if(pruning.keeps(child.forward.size()) && index->is_right_maximal(child)){
             // Add child to stack
             int64_t child_id = next_id;
             next_id++;
-            if(debug_mode){
+            if(!print_edges){}
+            else if(debug_mode){
                 std::string label_rev(label.rbegin(), label.rend());
-                std::cout << "\"" << label_rev << "\" -> \"" << (char)c + label_rev << "\" [label=\"" << c << "\"];\n";
+                output->write("\"" + label_rev + "\" -> \"" + (char)c + label_rev + "\" [label=\"" + (char)c + "\"];\n");
             }
             else
-                std::cout << f.node_id << " -> " << child_id << " [label=\"" << c << "\"];\n";
-            if(!stop_at_dollars || c != '$')
-                iteration_stack.push_back(Stack_frame(child,f.depth+1,c,child_id));
+                output->write_edge(f.node_id, child_id, c);
+            iteration_stack.push_back(Stack_frame(child,f.depth+1,c,child_id));
         }
-    }    
+    }
+    if(smallest_first){ // The smallest interval on top
+        std::stable_sort(iteration_stack.begin() + first_child, iteration_stack.end(), [](const Stack_frame& a, const Stack_frame& b){
+            return a.intervals.forward.size() > b.intervals.forward.size();
+        });
+    }
 }
 
-template<class t_bitvector>
-void BD_BWT_index_iterator<t_bitvector>::update_label(Stack_frame f){
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_iterator<t_bitvector, t_bwt>::update_label(Stack_frame f){
     while(label.size() > 0 && label.size() >= f.depth) // Unwind stack
         label.pop_back();
-    if(f.extension != 0)
+    if(f.depth > 0) // The root has no extension. Extensions can be 0x00, so do not test for that
         label.push_back(current.extension);    
 }
 
-template<class t_bitvector>
-bool BD_BWT_index_iterator<t_bitvector>::next(int64_t k){
+template<class t_bitvector, class t_bwt>
+bool BD_BWT_index_iterator<t_bitvector, t_bwt>::next(int64_t k){
     
     while(true){
-        if(iteration_stack.empty()) return false;
+        if(iteration_stack.empty()){
+            output->flush();
+            return false;
+        }
         
         current = iteration_stack.back(); iteration_stack.pop_back();
         update_label(current);
         
         if(current.depth == k) return true; // Stop recursing to children and give control back
 
-        push_right_maximal_children(current);
+        if(expands(current)) push_right_maximal_children(current);
 
     }
 }
 
-template<class t_bitvector>
-bool BD_BWT_index_iterator<t_bitvector>::next(){
-    if(iteration_stack.empty()) return false;
+template<class t_bitvector, class t_bwt>
+bool BD_BWT_index_iterator<t_bitvector, t_bwt>::next(){
+    if(iteration_stack.empty()){
+        output->flush();
+        return false;
+    }
     
     current = iteration_stack.back(); iteration_stack.pop_back();
     update_label(current);
-    push_right_maximal_children(current);
+    if(expands(current)) push_right_maximal_children(current);
         
     return true;
 }
@@ -0,0 +1,162 @@
+#ifndef LEVEL_ORDER_TRAVERSAL_HH
+#define LEVEL_ORDER_TRAVERSAL_HH
+
+#include "BD_BWT_index.hh"
+#include "Output_buffer.hh"
+#include "Suffix_link_tree_pruning.hh"
+#include <vector>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <iostream>
+
+/**
+ * Class BD_BWT_index_level_order_traversal
+ *
+ * Prints the suffix link tree of the given index one depth at a time. The nodes of a level are
+ * expanded in the order of their forward intervals, so that the rank queries of consecutive nodes
+ * go to nearby positions of the BWT instead of jumping across it as in the depth-first search.
+ * If the nodes W of a level are in this order, the children cW are in this order for every c, so
+ * the next level is sorted by a stable counting sort on c. Each level is split into contiguous
+ * parts that are expanded by n_threads threads, and the children are concatenated in the order
+ * of the parts. A part is expanded in slices of SLICE_SIZE nodes: the extensions of the nodes of a
+ * slice are computed with one left_extensions_batch, and the right-maximality of the extensions with
+ * one is_right_maximal_batch, so that the rank queries descend the wavelet trees together.
+ *
+ * The output is the same tree as the output of BD_BWT_index_iterator, but the nodes are numbered
+ * in the order in which their edges are printed: level by level, and within a level in the order
+ * of the intervals of the parents. The edges from a node are consecutive and in the order of the
+ * alphabet. The output does not depend on the number of threads. No debug mode. The rules of pruning
+ * cut the tree like in traverse_suffix_link_tree.
+ */
+template<class t_bitvector, class t_bwt = sdsl::wt_huff<t_bitvector>>
+class BD_BWT_index_level_order_traversal{
+
+private:
+
+    class Node{
+    public:
+        Interval_pair intervals;
+        int64_t id;
+        uint8_t extension; // The label on the arc between this node and its parent
+        Node(Interval_pair intervals, int64_t id, uint8_t extension) : intervals(intervals), id(id), extension(extension) {}
+        Node(){}
+    };
+
+    // The children found from a contiguous part of a level, and the space for a slice
+    class Part{
+    public:
+        std::vector<Node> children; // The ids are the ids of the parents until the level is numbered
+        std::vector<Node> requests, candidates;
+        std::vector<Interval_pair> intervals;
+        BD_BWT_index_batch_extensions extensions;
+        std::vector<bool> maximal;
+    };
+
+    enum { SLICE_SIZE = 256 };
+
+    const BD_BWT_index<t_bitvector, t_bwt>* index;
+    int64_t n_threads;
+
+    void expand(const std::vector<Node>& level, int64_t begin, int64_t end, int64_t depth, Part& part) const;
+
+public:
+
+    bool stop_at_dollars;
+    Suffix_link_tree_pruning pruning;
+    int64_t nodes; // Number of nodes printed by the last call to print
+    int64_t levels; // Number of levels in the last call to print
+    int64_t max_level_size; // The largest number of nodes on one level in the last call to print
+
+    BD_BWT_index_level_order_traversal(const BD_BWT_index<t_bitvector, t_bwt>* index, int64_t n_threads = 1)
+        : index(index), n_threads(std::max((int64_t)1, n_threads)), stop_at_dollars(false), nodes(0), levels(0), max_level_size(0) {}
+
+    // Prints the edges of the suffix link tree to out in level order. Returns the number of nodes.
+    int64_t print(Output_buffer& out);
+
+    // Prints to a stream through an Output_buffer
+    int64_t print(std::ostream& out){
+        Output_buffer buffer(out);
+        return print(buffer);
+    }
+};
+
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index_level_order_traversal<t_bitvector, t_bwt>::print(Output_buffer& out){
+    Interval empty_string(0, index->size()-1);
+    std::vector<Node> level(1, Node(Interval_pair(empty_string, empty_string), 0, 0));
+    std::vector<Part> parts(n_threads);
+    nodes = 1;
+    levels = 0;
+    max_level_size = 0;
+
+    for(int64_t depth = 0; !level.empty(); depth++){
+        levels++;
+        max_level_size = std::max(max_level_size, (int64_t)level.size());
+
+        // Small levels are not worth the threads
+        int64_t n_parts = std::min(n_threads, (int64_t)level.size() / 64 + 1);
+        std::vector<std::thread> threads;
+        for(int64_t p = 0; p < n_parts; p++){
+            int64_t begin = level.size() * p / n_parts, end = level.size() * (p+1) / n_parts;
+            if(p == n_parts - 1) expand(level, begin, end, depth, parts[p]);
+            else threads.push_back(std::thread(&BD_BWT_index_level_order_traversal::expand, this,
+                                               std::cref(level), begin, end, depth, std::ref(parts[p])));
+        }
+        for(std::thread& thread : threads) thread.join();
+
+        // Number the children in the order of the parts, print the edges and sort the children
+        // into the next level by their extensions. No child is extended with END, so the order of the
+        // bytes is the order of the BWT rows.
+        std::vector<int64_t> bucket_start(257, 0);
+        for(int64_t p = 0; p < n_parts; p++)
+            for(const Node& child : parts[p].children) bucket_start[child.extension + 1]++;
+        for(int64_t c = 0; c < 256; c++) bucket_start[c+1] += bucket_start[c];
+        std::vector<Node> next(bucket_start[256]);
+        for(int64_t p = 0; p < n_parts; p++){
+            for(Node& child : parts[p].children){
+                out.write_edge(child.id, nodes, child.extension);
+                child.id = nodes++;
+                next[bucket_start[child.extension]++] = child;
+            }
+            std::vector<Node>().swap(parts[p].children);
+        }
+        level.swap(next);
+    }
+    out.flush();
+    return nodes;
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_level_order_traversal<t_bitvector, t_bwt>::expand(const std::vector<Node>& level, int64_t begin, int64_t end,
+                                                                    int64_t depth, Part& part) const{
+    for(int64_t slice = begin; slice < end; slice += SLICE_SIZE){
+        part.requests.clear();
+        part.intervals.clear();
+        for(int64_t k = slice; k < std::min(end, slice + (int64_t)SLICE_SIZE); k++){
+            const Node& v = level[k];
+            if(stop_at_dollars && depth > 0 && v.extension == '$') continue;
+            if(!pruning.expands(depth, v.extension)) continue;
+            part.requests.push_back(v);
+            part.intervals.push_back(v.intervals);
+        }
+        index->left_extensions_batch(part.intervals.data(), part.intervals.size(), part.extensions);
+
+        part.candidates.clear();
+        part.intervals.clear();
+        for(int64_t r = 0; r < (int64_t)part.requests.size(); r++){
+            for(int64_t i = part.extensions.begin[r]; i < part.extensions.begin[r+1]; i++){ // In the order of the alphabet
+                uint8_t c = part.extensions.symbols[i];
+                if(c == BD_BWT_index<t_bitvector, t_bwt>::END) continue;
+                if(!pruning.keeps(part.extensions.intervals[i].forward.size())) continue;
+                part.candidates.push_back(Node(part.extensions.intervals[i], part.requests[r].id, c));
+                part.intervals.push_back(part.extensions.intervals[i]);
+            }
+        }
+        index->is_right_maximal_batch(part.intervals.data(), part.intervals.size(), part.maximal);
+        for(int64_t i = 0; i < (int64_t)part.candidates.size(); i++)
+            if(part.maximal[i]) part.children.push_back(part.candidates[i]);
+    }
+}
+
+#endif
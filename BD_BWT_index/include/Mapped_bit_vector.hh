@@ -0,0 +1,434 @@
+#ifndef MAPPED_BIT_VECTOR_HH
+#define MAPPED_BIT_VECTOR_HH
+
+#include <sdsl/int_vector.hpp>
+#include <sdsl/iterators.hpp>
+#include <sdsl/memory_management.hpp>
+#include <sdsl/util.hpp>
+#include <streambuf>
+#include <string>
+#include <queue>
+#include <stdexcept>
+#include <algorithm>
+
+/*
+ * Support for using a serialized BD_BWT_index directly from a memory-mapped file.
+ *
+ * Mapped_file maps a file read-only with the same sdsl memory_manager primitives that
+ * sdsl::int_vector_mapper uses. int_vector_mapper itself can only map a file that holds a
+ * single int_vector, so the index is instead read through a Mapped_streambuf over the whole
+ * mapping. Mapped_words recognizes that stream buffer on load and points into the mapping
+ * instead of copying. Mapped_bit_vector_il stores its bits and rank samples interleaved in
+ * Mapped_words, so the bitvectors and the rank directories of a loaded index both stay in
+ * the page cache, shared by all processes that map the same file.
+ */
+
+// A read-only memory mapping of a whole file. Unmapped on destruction.
+class Mapped_file{
+
+private:
+    int fd;
+    uint64_t file_size;
+    const char* data;
+
+public:
+    Mapped_file(std::string filename) : fd(-1), file_size(0), data(nullptr){
+        fd = sdsl::memory_manager::open_file_for_mmap(filename, std::ios_base::in);
+        if(fd == -1) throw std::runtime_error("Could not open " + filename);
+        file_size = sdsl::util::file_size(filename);
+        data = (const char*)sdsl::memory_manager::mmap_file(fd, file_size, std::ios_base::in);
+        if(data == nullptr){
+            sdsl::memory_manager::close_file_for_mmap(fd);
+            throw std::runtime_error("Could not memory-map " + filename);
+        }
+    }
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator=(const Mapped_file&) = delete;
+    ~Mapped_file(){
+        sdsl::memory_manager::mem_unmap((void*)data, file_size);
+        sdsl::memory_manager::close_file_for_mmap(fd);
+    }
+    const char* begin() const { return data; }
+    uint64_t size() const { return file_size; }
+};
+
+// An input stream buffer reading directly from a memory region.
+class Mapped_streambuf : public std::streambuf{
+public:
+    Mapped_streambuf(const char* begin, const char* end){
+        setg((char*)begin, (char*)begin, (char*)end);
+    }
+    const char* current() const { return gptr(); }
+    int64_t remaining() const { return egptr() - gptr(); }
+    void skip(int64_t bytes){ setg(eback(), gptr() + bytes, egptr()); } // gbump takes only an int
+};
+
+/*
+ * An array of 64-bit words that either owns its memory or points into a Mapped_streambuf.
+ *
+ * Serialized as the word count, a padding length and padding that aligns the words to 8 bytes
+ * in the output stream (when the stream can report its position), and the words.
+ * A mapped array refers to the mapping, which must outlive it.
+ */
+class Mapped_words{
+
+private:
+    sdsl::int_vector<64> owned;
+    const uint64_t* words;
+    uint64_t n_words;
+
+public:
+    typedef sdsl::int_vector<64>::size_type size_type;
+
+    Mapped_words() : words(nullptr), n_words(0) {}
+    Mapped_words(sdsl::int_vector<64>&& v) : owned(std::move(v)), words(owned.data()), n_words(owned.size()) {}
+    Mapped_words(const Mapped_words& other) : owned(other.owned), n_words(other.n_words){
+        words = other.is_mapped() ? other.words : owned.data();
+    }
+    Mapped_words(Mapped_words&& other) : owned(std::move(other.owned)), n_words(other.n_words){
+        words = other.is_mapped() ? other.words : owned.data();
+    }
+    Mapped_words& operator=(Mapped_words other){
+        swap(other);
+        return *this;
+    }
+
+    bool is_mapped() const { return words != owned.data() && n_words > 0; }
+    const uint64_t* data() const { return words; }
+    size_type size() const { return n_words; }
+    uint64_t operator[](size_type i) const { return words[i]; }
+
+    void swap(Mapped_words& other){
+        bool this_mapped = is_mapped(), other_mapped = other.is_mapped();
+        const uint64_t* this_words = words;
+        const uint64_t* other_words = other.words;
+        owned.swap(other.owned);
+        std::swap(n_words, other.n_words);
+        words = other_mapped ? other_words : owned.data();
+        other.words = this_mapped ? this_words : other.owned.data();
+    }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="") const{
+        sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = sdsl::write_member(n_words, out);
+        std::streamoff position = out.tellp();
+        uint8_t padding = (position < 0) ? 0 : (8 - (position + 1) % 8) % 8;
+        written_bytes += sdsl::write_member(padding, out);
+        const char zeros[8] = {0};
+        out.write(zeros, padding);
+        out.write((const char*)words, n_words * sizeof(uint64_t));
+        written_bytes += padding + n_words * sizeof(uint64_t);
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in){
+        uint64_t n = 0;
+        uint8_t padding = 0;
+        sdsl::read_member(n, in);
+        sdsl::read_member(padding, in);
+        char zeros[8];
+        in.read(zeros, padding);
+        Mapped_streambuf* mapped = dynamic_cast<Mapped_streambuf*>(in.rdbuf());
+        if(mapped != nullptr && (uintptr_t)mapped->current() % 8 == 0){
+            if(n > (uint64_t)mapped->remaining() / sizeof(uint64_t))
+                throw std::runtime_error("Truncated memory-mapped index");
+            owned = sdsl::int_vector<64>();
+            words = (const uint64_t*)mapped->current();
+            n_words = n;
+            mapped->skip(n * sizeof(uint64_t));
+        } else{ // Not mapped or not aligned: copy
+            // The count comes from the file and the stream may not know its size, so the words are
+            // read in blocks that grow geometrically, and a corrupted count fails at the end of the data
+            // instead of allocating it all at once.
+            owned = sdsl::int_vector<64>(std::min(n, (uint64_t)1 << 20));
+            uint64_t read_words = 0;
+            while(read_words < n){
+                if(read_words == owned.size()) owned.resize(std::min(n, 2 * owned.size()));
+                uint64_t count = owned.size() - read_words;
+                in.read((char*)(owned.data() + read_words), count * sizeof(uint64_t));
+                if((uint64_t)in.gcount() != count * sizeof(uint64_t)) throw std::runtime_error("Truncated BD_BWT_index");
+                read_words += count;
+            }
+            words = owned.data();
+            n_words = n;
+        }
+    }
+
+    // Bytes of memory owned by the array, zero if it points into a mapping
+    uint64_t owned_bytes() const { return owned.size() * sizeof(uint64_t); }
+};
+
+template<uint8_t t_b=1, uint32_t t_bs=512>
+class Mapped_rank_support_il;
+
+template<uint8_t t_b=1, uint32_t t_bs=512>
+class Mapped_select_support_il;
+
+/*
+ * A copy of sdsl::bit_vector_il that keeps its interleaved bits and rank samples in
+ * Mapped_words, so that it can be used in place from a memory-mapped index.
+ * Every t_bs bits of the original bitvector are preceded by a 64-bit cumulative count of
+ * set bits, so a rank query reads one sample and the words after it.
+ */
+template<uint32_t t_bs=512>
+class Mapped_bit_vector_il{
+    static_assert(t_bs >= 64, "Mapped_bit_vector_il: blocksize must be be at least 64 bits.");
+    static_assert(sdsl::power_of_two(t_bs), "Mapped_bit_vector_il: blocksize must be a power of two.");
+
+public:
+    typedef sdsl::bit_vector::size_type size_type;
+    typedef size_type value_type;
+    typedef sdsl::bit_vector::difference_type difference_type;
+    typedef sdsl::random_access_const_iterator<Mapped_bit_vector_il> iterator;
+    typedef iterator const_iterator;
+    typedef sdsl::bv_tag index_category;
+
+    friend class Mapped_rank_support_il<1,t_bs>;
+    friend class Mapped_rank_support_il<0,t_bs>;
+    friend class Mapped_select_support_il<1,t_bs>;
+    friend class Mapped_select_support_il<0,t_bs>;
+
+    typedef Mapped_rank_support_il<1,t_bs> rank_1_type;
+    typedef Mapped_rank_support_il<0,t_bs> rank_0_type;
+    typedef Mapped_select_support_il<1,t_bs> select_1_type;
+    typedef Mapped_select_support_il<0,t_bs> select_0_type;
+
+private:
+    size_type m_size = 0; // Size of the original bitvector
+    size_type m_block_num = 0; // Number of words in m_data
+    size_type m_superblocks = 0;
+    size_type m_block_shift = 0;
+    Mapped_words m_data; // Interleaved cumulative counts and bits
+    Mapped_words m_rank_samples; // Samples of the cumulative counts for the binary search of select
+
+public:
+    Mapped_bit_vector_il() {}
+
+    Mapped_bit_vector_il(const sdsl::bit_vector& bv){
+        m_size = bv.size();
+        m_superblocks = (m_size + t_bs) / t_bs;
+        m_block_shift = sdsl::bits::hi(t_bs);
+        size_type blocks = (m_size + 64) / 64;
+        size_type mem = blocks + m_superblocks + 1; // bits, cumulative counts, count after the last block
+        sdsl::int_vector<64> data(mem);
+        m_block_num = mem;
+
+        const uint64_t* bvp = bv.data();
+        size_type j = 0;
+        size_type cum_sum = 0;
+        size_type sample_rate = t_bs / 64;
+        for(size_type i = 0, sample_cnt = sample_rate; i < blocks; ++i, ++sample_cnt){
+            if(sample_cnt == sample_rate){
+                data[j] = cum_sum;
+                sample_cnt = 0;
+                j++;
+            }
+            data[j] = bvp[i];
+            cum_sum += sdsl::bits::cnt(data[j]);
+            j++;
+        }
+        data[j] = cum_sum;
+
+        sdsl::int_vector<64> rank_samples;
+        if(m_block_num > 1024*64)
+            rank_samples.resize(std::min(1024ULL, 1ULL << sdsl::bits::hi(m_superblocks)));
+        init_rank_samples(data, rank_samples);
+        m_data = Mapped_words(std::move(data));
+        m_rank_samples = Mapped_words(std::move(rank_samples));
+    }
+
+    value_type operator[](size_type i) const{
+        size_type bs = i >> m_block_shift;
+        size_type block = bs + (i >> 6) + 1;
+        return ((m_data[block] >> (i & 63)) & 1ULL);
+    }
+
+    size_type size() const { return m_size; }
+
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="") const{
+        sdsl::structure_tree_node* child = sdsl::structure_tree::add_child(v, name, sdsl::util::class_name(*this));
+        size_type written_bytes = 0;
+        written_bytes += sdsl::write_member(m_size, out, child, "size");
+        written_bytes += sdsl::write_member(m_block_num, out, child, "block_num");
+        written_bytes += sdsl::write_member(m_superblocks, out, child, "superblocks");
+        written_bytes += sdsl::write_member(m_block_shift, out, child, "block_shift");
+        written_bytes += m_data.serialize(out, child, "data");
+        written_bytes += m_rank_samples.serialize(out, child, "rank_samples");
+        sdsl::structure_tree::add_size(child, written_bytes);
+        return written_bytes;
+    }
+
+    void load(std::istream& in){
+        sdsl::read_member(m_size, in);
+        sdsl::read_member(m_block_num, in);
+        sdsl::read_member(m_superblocks, in);
+        sdsl::read_member(m_block_shift, in);
+        m_data.load(in);
+        m_rank_samples.load(in);
+    }
+
+    void swap(Mapped_bit_vector_il& bv){
+        if(this != &bv){
+            std::swap(m_size, bv.m_size);
+            std::swap(m_block_num, bv.m_block_num);
+            std::swap(m_superblocks, bv.m_superblocks);
+            std::swap(m_block_shift, bv.m_block_shift);
+            m_data.swap(bv.m_data);
+            m_rank_samples.swap(bv.m_rank_samples);
+        }
+    }
+
+    iterator begin() const { return iterator(this, 0); }
+    iterator end() const { return iterator(this, size()); }
+
+private:
+    // Breadth-first samples of the superblock counts, for a cache-friendly binary search in select
+    void init_rank_samples(const sdsl::int_vector<64>& data, sdsl::int_vector<64>& rank_samples){
+        uint32_t block_size_U64 = sdsl::bits::hi(t_bs >> 6);
+        size_type idx = 0;
+        std::queue<size_type> lbs, rbs;
+        lbs.push(0); rbs.push(m_superblocks);
+        while(!lbs.empty()){
+            size_type lb = lbs.front(); lbs.pop();
+            size_type rb = rbs.front(); rbs.pop();
+            if(idx < rank_samples.size()){
+                size_type mid = lb + (rb - lb) / 2;
+                size_type pos = (mid << block_size_U64) + mid;
+                rank_samples[idx++] = data[pos];
+                lbs.push(lb); rbs.push(mid);
+                lbs.push(mid + 1); rbs.push(rb);
+            }
+        }
+    }
+};
+
+// Rank support of Mapped_bit_vector_il. Has no data of its own.
+template<uint8_t t_b, uint32_t t_bs>
+class Mapped_rank_support_il{
+    static_assert(t_b == 1 or t_b == 0, "Mapped_rank_support_il only supports bitpatterns 0 or 1.");
+
+public:
+    typedef sdsl::bit_vector::size_type size_type;
+    typedef Mapped_bit_vector_il<t_bs> bit_vector_type;
+    enum { bit_pat = t_b };
+    enum { bit_pat_len = (uint8_t)1 };
+
+private:
+    const bit_vector_type* m_v;
+
+    size_type rank1(size_type i) const{
+        size_type block_shift = sdsl::bits::hi(t_bs);
+        size_type superblock = i >> block_shift;
+        size_type position = (superblock << sdsl::bits::hi(t_bs >> 6)) + superblock;
+        const uint64_t* data = m_v->m_data.data();
+        uint64_t result = data[position];
+        const uint64_t* B = data + position + 1;
+        uint64_t rem = i & 63;
+        uint64_t bits = (i & (t_bs - 1)) - rem;
+        while(bits){
+            result += sdsl::bits::cnt(*B++);
+            bits -= 64;
+        }
+        result += sdsl::bits::cnt(*B & sdsl::bits::lo_set[rem]);
+        return result;
+    }
+
+public:
+    Mapped_rank_support_il(const bit_vector_type* v=nullptr) : m_v(v) {}
+
+    size_type rank(size_type i) const{
+        if(t_b) return rank1(i);
+        return i - rank1(i);
+    }
+    size_type operator()(size_type i) const { return rank(i); }
+
+    // Starts loading the sample and the word that rank(i) reads into the cache
+    void prefetch(size_type i) const{
+        size_type superblock = i >> sdsl::bits::hi(t_bs);
+        size_type position = (superblock << sdsl::bits::hi(t_bs >> 6)) + superblock;
+        const uint64_t* data = m_v->m_data.data();
+        __builtin_prefetch(data + position);
+        __builtin_prefetch(data + position + 1 + ((i & (t_bs - 1)) >> 6));
+    }
+
+    size_type size() const { return m_v->size(); }
+    void set_vector(const bit_vector_type* v=nullptr) { m_v = v; }
+    Mapped_rank_support_il& operator=(const Mapped_rank_support_il& rs){
+        if(this != &rs) set_vector(rs.m_v);
+        return *this;
+    }
+    void swap(Mapped_rank_support_il&) {}
+    void load(std::istream&, const bit_vector_type* v=nullptr) { set_vector(v); }
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="") const{
+        return sdsl::serialize_empty_object(out, v, name, this);
+    }
+};
+
+// Select support of Mapped_bit_vector_il: binary search over the superblock counts. Has no data of its own.
+template<uint8_t t_b, uint32_t t_bs>
+class Mapped_select_support_il{
+    static_assert(t_b == 1 or t_b == 0, "Mapped_select_support_il only supports bitpatterns 0 or 1.");
+
+public:
+    typedef sdsl::bit_vector::size_type size_type;
+    typedef Mapped_bit_vector_il<t_bs> bit_vector_type;
+    enum { bit_pat = t_b };
+    enum { bit_pat_len = (uint8_t)1 };
+
+private:
+    const bit_vector_type* m_v;
+
+    // Number of bits equal to t_b before the given superblock
+    size_type count_before(size_type superblock, uint64_t cumulative_ones) const{
+        if(t_b) return cumulative_ones;
+        return (superblock << sdsl::bits::hi(t_bs)) - cumulative_ones;
+    }
+
+public:
+    Mapped_select_support_il(const bit_vector_type* v=nullptr) : m_v(v) {}
+
+    // Returns the position of the i-th occurrence of t_b in the bitvector
+    size_type select(size_type i) const{
+        size_type block_shift = sdsl::bits::hi(t_bs);
+        size_type block_size_U64 = sdsl::bits::hi(t_bs >> 6);
+        size_type lb = 0, rb = m_v->m_superblocks; // Search interval [lb..rb)
+        size_type idx = 0; // Index in the rank samples
+        while(lb < rb){
+            size_type mid = (lb + rb) / 2;
+            uint64_t ones;
+            if(idx < m_v->m_rank_samples.size()){
+                ones = m_v->m_rank_samples[idx];
+                idx = (count_before(mid, ones) >= i) ? (idx << 1) + 1 : (idx << 1) + 2;
+            } else ones = m_v->m_data[(mid << block_size_U64) + mid];
+            if(count_before(mid, ones) >= i) rb = mid;
+            else lb = mid + 1;
+        }
+        size_type result = (rb - 1) << block_shift;
+        const uint64_t* w = m_v->m_data.data() + ((rb - 1) << block_size_U64) + (rb - 1);
+        i -= count_before(rb - 1, *w);
+        ++w;
+        size_type count = sdsl::bits::cnt(t_b ? *w : ~*w);
+        while(count < i){
+            i -= count; ++w;
+            count = sdsl::bits::cnt(t_b ? *w : ~*w);
+            result += 64;
+        }
+        result += sdsl::bits::sel(t_b ? *w : ~*w, i);
+        return result;
+    }
+    size_type operator()(size_type i) const { return select(i); }
+    size_type size() const { return m_v->size(); }
+    void set_vector(const bit_vector_type* v=nullptr) { m_v = v; }
+    Mapped_select_support_il& operator=(const Mapped_select_support_il& ss){
+        if(this != &ss) set_vector(ss.m_v);
+        return *this;
+    }
+    void swap(Mapped_select_support_il&) {}
+    void load(std::istream&, const bit_vector_type* v=nullptr) { set_vector(v); }
+    size_type serialize(std::ostream& out, sdsl::structure_tree_node* v=nullptr, std::string name="") const{
+        return sdsl::serialize_empty_object(out, v, name, this);
+    }
+};
+
+#endif
@@ -0,0 +1,182 @@
+#ifndef OUTPUT_BUFFER_HH
+#define OUTPUT_BUFFER_HH
+
+#include <vector>
+#include <string>
+#include <ostream>
+#include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Binary_edge_list.hh"
+
+/*
+ * Buffered output of the suffix link tree. Collects the output into a large buffer, formats
+ * integers by hand and writes full buffers directly to a file descriptor with write(2), or
+ * to a std::ostream if constructed with one. Flushes when destroyed.
+ *
+ * write_edge writes dot lines, or records of the binary edge list format between
+ * begin_binary_edge_list and end_binary_edge_list.
+ */
+class Output_buffer{
+
+private:
+    std::vector<char> buffer;
+    int64_t used;
+    int fd; // -1 if writing to out
+    bool owns_fd;
+    std::ostream* out;
+    bool binary; // Between begin_binary_edge_list and end_binary_edge_list
+    int64_t binary_edges; // Edges written in binary
+    int64_t binary_bytes; // Bytes of edge records written in binary
+    off_t header_offset; // Position of the binary edge list header in the file
+
+    void write_to_sink(const char* data, int64_t n){
+        if(out != nullptr){
+            out->write(data, n);
+            return;
+        }
+        while(n > 0){
+            ssize_t written = ::write(fd, data, n);
+            if(written < 0){
+                if(errno == EINTR) continue;
+                throw std::runtime_error("Failed to write output: " + std::string(std::strerror(errno)));
+            }
+            data += written;
+            n -= written;
+        }
+    }
+
+public:
+    enum { DEFAULT_BUFFER_SIZE = 1 << 20 };
+
+    // Writes to the file descriptor, e.g. 1 for stdout. Does not close it.
+    explicit Output_buffer(int fd, int64_t buffer_size = DEFAULT_BUFFER_SIZE)
+        : buffer(buffer_size), used(0), fd(fd), owns_fd(false), out(nullptr), binary(false) {}
+
+    // Creates or truncates the file. Throws std::runtime_error if that fails.
+    explicit Output_buffer(const std::string& filename, int64_t buffer_size = DEFAULT_BUFFER_SIZE)
+        : buffer(buffer_size), used(0), fd(-1), owns_fd(true), out(nullptr), binary(false){
+        fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if(fd < 0) throw std::runtime_error("Failed to open " + filename + ": " + std::strerror(errno));
+    }
+
+    explicit Output_buffer(std::ostream& out, int64_t buffer_size = DEFAULT_BUFFER_SIZE)
+        : buffer(buffer_size), used(0), fd(-1), owns_fd(false), out(&out), binary(false) {}
+
+    Output_buffer(const Output_buffer&) = delete;
+    Output_buffer& operator=(const Output_buffer&) = delete;
+
+    ~Output_buffer(){
+        try{
+            flush();
+        } catch(std::runtime_error& e){} // Destructors must not throw. Call flush to see the error.
+        if(owns_fd) ::close(fd);
+    }
+
+    void flush(){
+        if(used > 0) write_to_sink(buffer.data(), used);
+        used = 0;
+        if(out != nullptr) out->flush();
+    }
+
+    void write(const char* data, int64_t n){
+        if(used + n > (int64_t)buffer.size()){
+            flush();
+            if(n > (int64_t)buffer.size()){
+                write_to_sink(data, n);
+                return;
+            }
+        }
+        std::memcpy(buffer.data() + used, data, n);
+        used += n;
+    }
+
+    void write(const std::string& s){ write(s.data(), s.size()); }
+
+    void put(char c){
+        if(used == (int64_t)buffer.size()) flush();
+        buffer[used++] = c;
+    }
+
+    void write_int(int64_t x){
+        char digits[20];
+        uint64_t y = x < 0 ? -(uint64_t)x : x;
+        int64_t k = 0;
+        do{
+            digits[k++] = '0' + y % 10;
+            y /= 10;
+        } while(y > 0);
+        if(used + k + 1 > (int64_t)buffer.size()) flush();
+        if(x < 0) buffer[used++] = '-';
+        while(k > 0) buffer[used++] = digits[--k];
+    }
+
+    // Writes the line "from -> to [label="c"];" of the dot format
+    void write_dot_edge(int64_t from, int64_t to, uint8_t c){
+        write_int(from);
+        write(" -> ", 4);
+        write_int(to);
+        write(" [label=\"", 9);
+        put(c);
+        write("\"];\n", 4);
+    }
+    
+    // Writes a record of the binary edge list format. The child must be the number of edges so far plus one.
+    void write_binary_edge(int64_t from, int64_t to, uint8_t c){
+        if(to != binary_edges + 1 || from >= to || from < 0)
+            throw std::runtime_error("Binary edge lists need the children numbered in the order of the edges");
+        if(used + 11 > (int64_t)buffer.size()) flush();
+        int64_t start = used;
+        uint64_t delta = to - from;
+        while(delta >= 0x80){
+            buffer[used++] = (char)(0x80 | (delta & 0x7F));
+            delta >>= 7;
+        }
+        buffer[used++] = (char)delta;
+        buffer[used++] = (char)c;
+        binary_bytes += used - start;
+        binary_edges++;
+    }
+    
+    void write_edge(int64_t from, int64_t to, uint8_t c){
+        if(binary) write_binary_edge(from, to, c);
+        else write_dot_edge(from, to, c);
+    }
+    
+    // Reserves space for the header of a binary edge list and switches write_edge to binary records.
+    // The file descriptor must be seekable to fill in the header later. Throws std::runtime_error if not.
+    void begin_binary_edge_list(){
+        if(out != nullptr) throw std::runtime_error("Binary edge lists can only be written to files");
+        header_offset = ::lseek(fd, 0, SEEK_CUR);
+        if(header_offset < 0) throw std::runtime_error("Binary output needs a seekable output file");
+        header_offset += used;
+        Binary_edge_list_header header;
+        std::memset(&header, 0, sizeof(header));
+        write((const char*)&header, sizeof(header));
+        binary = true;
+        binary_edges = 0;
+        binary_bytes = 0;
+    }
+    
+    // Writes the header of the binary edge list with the counts and the given edge alphabet
+    void end_binary_edge_list(const std::vector<uint8_t>& alphabet){
+        flush();
+        Binary_edge_list_header header;
+        std::memset(&header, 0, sizeof(header));
+        std::memcpy(header.magic, Binary_edge_list_header::expected_magic(), 8);
+        header.version = Binary_edge_list_header::VERSION;
+        header.alphabet_size = alphabet.size();
+        header.nodes = binary_edges + 1;
+        header.edges = binary_edges;
+        header.data_bytes = binary_bytes;
+        std::copy(alphabet.begin(), alphabet.end(), header.alphabet);
+        if(::pwrite(fd, &header, sizeof(header), header_offset) != sizeof(header))
+            throw std::runtime_error("Failed to write the binary edge list header: " + std::string(std::strerror(errno)));
+        binary = false;
+    }
+};
+
+#endif
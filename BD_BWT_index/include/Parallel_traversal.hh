@@ -0,0 +1,415 @@
+#ifndef PARALLEL_TRAVERSAL_HH
+#define PARALLEL_TRAVERSAL_HH
+
+#include "BD_BWT_index.hh"
+#include "Output_buffer.hh"
+#include "Suffix_link_tree_pruning.hh"
+#include <deque>
+#include <algorithm>
+#include <vector>
+#include <string>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <iostream>
+
+/**
+ * Class BD_BWT_index_parallel_traversal
+ *
+ * Prints the suffix link tree of the given index in dot format using many threads. The output
+ * is identical to the output of BD_BWT_index_iterator, including the node ids.
+ *
+ * Every worker thread runs the same depth-first search as the iterator on its own stack. A worker
+ * whose stack is empty steals the bottom frame of the stack of another worker. In the sequential
+ * search that frame would be expanded after everything else on the stack of the victim, so the
+ * edges found from it form a segment of the output that comes right after the current segment of
+ * the victim. The segments form a linked list in the output order. Every worker appends edges only
+ * to its own segment and hands them to the calling thread in batches. The calling thread prints the
+ * batches of the first unprinted segment, the head, as they arrive, and moves on to the next segment
+ * when the head has finished.
+ *
+ * The edges of the segments after the head wait in memory. When more than max_buffered_edges edges
+ * wait, the workers stop stealing and only the worker of the head segment goes on, until the
+ * calling thread has printed enough of it. An exception in a worker or in the output stops all
+ * threads and is rethrown by print.
+ *
+ * Node ids are numbered in the order of the edges, so the id of a child is the number of edges in
+ * the preceding segments plus its index in its segment plus one. The ids of a segment are fixed
+ * when all preceding segments have finished.
+ *
+ * With smallest_first, the children are visited in the order of traverse_suffix_link_tree with
+ * smallest_first, and the output is the same as its output. The rules of pruning cut the tree like
+ * in traverse_suffix_link_tree.
+ */
+template<class t_bitvector, class t_bwt = sdsl::wt_huff<t_bitvector>>
+class BD_BWT_index_parallel_traversal{
+
+private:
+
+    class Stack_frame{
+    public:
+        Interval_pair intervals;
+        int64_t depth;
+        int64_t edge_index; // The index of the edge to this node in its segment, -1 for the first node of a segment
+        uint8_t extension; // The label on the arc between this node and its parent
+        Stack_frame(Interval_pair intervals, int64_t depth, int64_t edge_index, uint8_t extension)
+            : intervals(intervals), depth(depth), edge_index(edge_index), extension(extension) {}
+        Stack_frame(){}
+    };
+
+    class Edge{
+    public:
+        int64_t parent; // The index of the edge to the parent in the same segment, -1 for the first node of the segment
+        uint8_t c;
+        Edge(int64_t parent, uint8_t c) : parent(parent), c(c) {}
+    };
+
+    class Segment{
+    public:
+        Segment* next; // The next segment in the output
+        Segment* source; // The segment of the edge to the first node, nullptr for the root
+        int64_t source_index; // The index of that edge in source
+        int64_t size; // Number of edges appended, used only by the worker of the segment
+        std::vector<Edge> edges; // Edges not handed to the printer yet, used only by the worker
+        std::string text; // The same edges in dot format in debug mode
+        std::vector<Edge> ready; // Edges handed to the printer. Guarded by output_mutex, like ready_text and finished.
+        std::string ready_text;
+        bool finished; // No more edges will be appended
+        std::atomic<int64_t> unprinted; // Edges handed to the printer and not printed yet
+        int64_t first_id; // Id of the child of the first edge, set when the segment becomes the head
+        int64_t printed; // Number of printed edges, used only by the printer
+        Segment(Segment* next, Segment* source, int64_t source_index) : next(next), source(source),
+            source_index(source_index), size(0), finished(false), unprinted(0), first_id(0), printed(0) {}
+    };
+
+    class Worker{
+    public:
+        std::mutex mutex; // Guards stack, current and label
+        std::deque<Stack_frame> stack;
+        Segment* current; // The segment the frames on the stack belong to. Written only by the worker itself.
+        std::string label; // The string on the path from the root to the current node, only in debug mode
+        std::vector<std::unique_ptr<Segment>> segments; // The segments created by this worker
+        BD_BWT_index_extensions children;
+        std::vector<Stack_frame> new_frames;
+        int64_t steals;
+        Worker() : current(nullptr), steals(0) {}
+    };
+
+    static const int64_t batch_size = 1024; // Edges handed to the printer at a time
+
+    const BD_BWT_index<t_bitvector, t_bwt>* index;
+    bool debug_mode;
+    int64_t n_threads;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::atomic<int64_t> pending; // Frames pushed to a stack that have not been expanded yet
+    std::atomic<int64_t> buffered; // Edges handed to the printer and not printed yet
+    std::atomic<Segment*> head; // The segment being printed
+    std::atomic<bool> failed;
+    std::exception_ptr error; // The first exception of any thread, guarded by output_mutex
+    std::mutex output_mutex; // The printer waits on output_cv for edges of the head segment
+    std::condition_variable output_cv;
+    std::mutex progress_mutex; // The workers wait on progress_cv for printed edges or for work
+    std::condition_variable progress_cv;
+
+    void run_worker(int64_t w, Stack_frame* root);
+    void run_worker_loop(Worker& worker, int64_t w, Stack_frame* root);
+    bool may_advance(const Worker& worker) const;
+    bool steal(int64_t w, Stack_frame& f);
+    void expand(Worker& worker, const Stack_frame& f);
+    void hand_over(Segment* segment, bool finish);
+    void print_segment(Segment* segment, Output_buffer& out);
+    void print_batch(Segment* segment, const std::vector<Edge>& batch, const std::string& text, Output_buffer& out);
+    void fail(std::exception_ptr e);
+    void notify_progress();
+
+public:
+
+    bool stop_at_dollars;
+    bool smallest_first; // Visit the children with the smallest intervals first
+    Suffix_link_tree_pruning pruning;
+    int64_t max_buffered_edges; // About 16 bytes each
+    int64_t nodes; // Number of nodes printed by the last call to print
+    int64_t steals; // Number of stolen frames in the last call to print
+
+    BD_BWT_index_parallel_traversal(const BD_BWT_index<t_bitvector, t_bwt>* index, int64_t n_threads, bool debug_mode = false)
+        : index(index), debug_mode(debug_mode), n_threads(std::max((int64_t)1, n_threads)), pending(0), buffered(0),
+          head(nullptr), failed(false), stop_at_dollars(false), smallest_first(false), max_buffered_edges(1 << 20),
+          nodes(0), steals(0) {}
+
+    // Prints the edges of the suffix link tree to out in the same order and with the same
+    // node ids as BD_BWT_index_iterator. Returns the number of nodes.
+    int64_t print(Output_buffer& out);
+    
+    // Prints to a stream through an Output_buffer
+    int64_t print(std::ostream& out){
+        Output_buffer buffer(out);
+        return print(buffer);
+    }
+};
+
+template<class t_bitvector, class t_bwt>
+int64_t BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::print(Output_buffer& out){
+    workers.clear();
+    for(int64_t w = 0; w < n_threads; w++) workers.push_back(std::unique_ptr<Worker>(new Worker()));
+
+    // The first worker starts from the root, the others start by stealing
+    Interval empty_string(0, index->size()-1);
+    Stack_frame root(Interval_pair(empty_string, empty_string), 0, -1, 0);
+    Segment* root_segment = new Segment(nullptr, nullptr, 0);
+    workers[0]->segments.push_back(std::unique_ptr<Segment>(root_segment));
+    workers[0]->current = root_segment;
+    pending = 1;
+    buffered = 0;
+    head = root_segment;
+    failed = false;
+    error = nullptr;
+
+    std::vector<std::thread> threads;
+    for(int64_t w = 0; w < n_threads; w++)
+        threads.push_back(std::thread(&BD_BWT_index_parallel_traversal::run_worker, this, w, w == 0 ? &root : nullptr));
+
+    // Print the segments in order. A finished segment gets no new successors.
+    nodes = 1;
+    try{
+        for(Segment* segment = root_segment; segment != nullptr && !failed; segment = segment->next){
+            segment->first_id = nodes;
+            head = segment;
+            notify_progress();
+            print_segment(segment, out);
+            nodes += segment->printed;
+        }
+    } catch(...){
+        fail(std::current_exception());
+    }
+
+    for(std::thread& thread : threads) thread.join();
+    steals = 0;
+    for(auto& worker : workers) steals += worker->steals;
+    workers.clear();
+    if(error) std::rethrow_exception(error);
+    out.flush();
+    return nodes;
+}
+
+// Prints the batches of the segment as its worker hands them over, until it has finished
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::print_segment(Segment* segment, Output_buffer& out){
+    std::vector<Edge> batch;
+    std::string text;
+    while(true){
+        bool finished;
+        {
+            std::unique_lock<std::mutex> lock(output_mutex);
+            output_cv.wait(lock, [this, segment](){
+                return !segment->ready.empty() || segment->finished || failed;
+            });
+            if(failed) return;
+            batch.clear();
+            text.clear();
+            batch.swap(segment->ready);
+            text.swap(segment->ready_text);
+            finished = segment->finished;
+        }
+        print_batch(segment, batch, text, out);
+        segment->printed += batch.size();
+        if(!batch.empty()){
+            segment->unprinted -= batch.size();
+            buffered -= batch.size();
+            notify_progress();
+        }
+        if(finished) return;
+    }
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::print_batch(Segment* segment, const std::vector<Edge>& batch,
+                                                                     const std::string& text, Output_buffer& out){
+    if(debug_mode){
+        out.write(text);
+        return;
+    }
+    int64_t first_node = segment->source == nullptr ? 0 : segment->source->first_id + segment->source_index;
+    for(int64_t i = 0; i < (int64_t)batch.size(); i++){
+        const Edge& e = batch[i];
+        int64_t parent = e.parent == -1 ? first_node : segment->first_id + e.parent;
+        out.write_edge(parent, segment->first_id + segment->printed + i, e.c);
+    }
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::run_worker(int64_t w, Stack_frame* root){
+    Worker& worker = *workers[w];
+    try{
+        run_worker_loop(worker, w, root);
+    } catch(...){
+        if(worker.current != nullptr){
+            std::lock_guard<std::mutex> lock(output_mutex);
+            worker.current->finished = true;
+        }
+        fail(std::current_exception());
+    }
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::run_worker_loop(Worker& worker, int64_t w, Stack_frame* root){
+    if(root != nullptr){
+        if(pruning.expands(0, 0)) expand(worker, *root);
+        if(--pending == 0) notify_progress();
+    }
+    int64_t idle_rounds = 0;
+    while(!failed){
+        if(!may_advance(worker) && pending > 0){
+            std::unique_lock<std::mutex> lock(progress_mutex);
+            progress_cv.wait(lock, [this, &worker](){ return may_advance(worker) || pending == 0; });
+        }
+        Stack_frame f;
+        bool found = false;
+        Segment* finished = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            if(!worker.stack.empty()){
+                f = worker.stack.back();
+                worker.stack.pop_back();
+                found = true;
+                if(debug_mode){
+                    worker.label.resize(f.depth - 1);
+                    worker.label.push_back(f.extension);
+                }
+            } else{
+                // Nothing can be stolen from the current segment anymore
+                finished = worker.current;
+                worker.current = nullptr;
+            }
+        }
+        if(!found){
+            if(finished != nullptr) hand_over(finished, true);
+            if(pending == 0) return;
+            if(!may_advance(worker)) continue;
+            found = steal(w, f);
+            if(!found){ // Back off from 1 microsecond to 1 millisecond, or until something is printed
+                std::unique_lock<std::mutex> lock(progress_mutex);
+                progress_cv.wait_for(lock, std::chrono::microseconds(1 << std::min(idle_rounds++, (int64_t)10)));
+                continue;
+            }
+        }
+        idle_rounds = 0;
+        expand(worker, f);
+        if(--pending == 0) notify_progress();
+    }
+}
+
+// The worker of the head segment goes on until its printed edges fall behind by max_buffered_edges.
+// The others go on, or steal, while fewer than max_buffered_edges edges wait for the printer.
+template<class t_bitvector, class t_bwt>
+bool BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::may_advance(const Worker& worker) const{
+    if(failed) return true;
+    Segment* segment = worker.current;
+    if(segment != nullptr && segment == head.load()) return segment->unprinted < max_buffered_edges;
+    return buffered < max_buffered_edges;
+}
+
+// Takes the bottom frame of the stack of some other worker and starts a new segment for it after
+// the current segment of the victim
+template<class t_bitvector, class t_bwt>
+bool BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::steal(int64_t w, Stack_frame& f){
+    Worker& thief = *workers[w];
+    for(int64_t k = 1; k < n_threads; k++){
+        Worker& victim = *workers[(w + k) % n_threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if(victim.stack.empty()) continue;
+        f = victim.stack.front();
+        victim.stack.pop_front();
+        Segment* segment = new Segment(victim.current->next, victim.current, f.edge_index);
+        victim.current->next = segment;
+        thief.segments.push_back(std::unique_ptr<Segment>(segment));
+        {
+            std::lock_guard<std::mutex> thief_lock(thief.mutex);
+            thief.current = segment;
+            if(debug_mode){
+                // The parent of every frame on the stack is on the path to the current node of the victim
+                thief.label = victim.label.substr(0, f.depth - 1);
+                thief.label.push_back(f.extension);
+            }
+        }
+        f.edge_index = -1;
+        thief.steals++;
+        return true;
+    }
+    return false;
+}
+
+// Appends the edges to the right-maximal children of f to the current segment of the worker
+// and pushes the children to its stack, like BD_BWT_index_iterator::push_right_maximal_children
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::expand(Worker& worker, const Stack_frame& f){
+    Segment* segment = worker.current;
+    worker.new_frames.clear();
+    index->left_extensions(f.intervals, worker.children);
+    for(int64_t i = 0; i < worker.children.count; i++){ // In the order of the alphabet
+        uint8_t c = worker.children.symbols[i];
+        if(c == BD_BWT_index<t_bitvector, t_bwt>::END) continue;
+        Interval_pair child = worker.children.intervals[i];
+        if(!pruning.keeps(child.forward.size())) continue;
+        if(!index->is_right_maximal(child)) continue;
+        int64_t edge_index = segment->size++;
+        segment->edges.push_back(Edge(f.edge_index, c));
+        if(debug_mode){
+            std::string label_rev(worker.label.rbegin(), worker.label.rend());
+            segment->text += "\"" + label_rev + "\" -> \"" + (char)c + label_rev + "\" [label=\"" + (char)c + "\"];\n";
+        }
+        if((!stop_at_dollars || c != '$') && pruning.expands(f.depth+1, c))
+            worker.new_frames.push_back(Stack_frame(child, f.depth+1, edge_index, c));
+    }
+    if((int64_t)segment->edges.size() >= batch_size) hand_over(segment, false);
+    if(worker.new_frames.empty()) return;
+    if(smallest_first){ // The smallest interval on top
+        std::stable_sort(worker.new_frames.begin(), worker.new_frames.end(), [](const Stack_frame& a, const Stack_frame& b){
+            return a.intervals.forward.size() > b.intervals.forward.size();
+        });
+    }
+    pending += worker.new_frames.size();
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    for(const Stack_frame& child : worker.new_frames) worker.stack.push_back(child);
+}
+
+// Gives the edges appended to the segment since the last call to the printer
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::hand_over(Segment* segment, bool finish){
+    int64_t count = segment->edges.size();
+    segment->unprinted += count; // Before the printer can subtract the edges
+    buffered += count;
+    {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        segment->ready.insert(segment->ready.end(), segment->edges.begin(), segment->edges.end());
+        segment->ready_text += segment->text;
+        if(finish) segment->finished = true;
+    }
+    segment->edges.clear();
+    segment->text.clear();
+    output_cv.notify_one();
+}
+
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::fail(std::exception_ptr e){
+    {
+        std::lock_guard<std::mutex> lock(output_mutex);
+        if(!error) error = e;
+        failed = true;
+    }
+    output_cv.notify_all();
+    notify_progress();
+}
+
+// Wakes up the workers waiting for printed edges. Taking the mutex orders the notification after
+// the check of a worker that is about to wait.
+template<class t_bitvector, class t_bwt>
+void BD_BWT_index_parallel_traversal<t_bitvector, t_bwt>::notify_progress(){
+    { std::lock_guard<std::mutex> lock(progress_mutex); }
+    progress_cv.notify_all();
+}
+
+#endif
@@ -0,0 +1,219 @@
+#ifndef SEQUENCE_PARSER_HH
+#define SEQUENCE_PARSER_HH
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+/*
+ * Concatenates the sequences of a FASTA or FASTQ file in memory into one buffer, with the separator
+ * before each record that has a nonempty sequence and lowercase letters in upper case. The file is
+ * FASTQ if its first nonspace character is '@'. In FASTA, whitespace at the ends of the lines is
+ * removed and empty lines are skipped, and the lines before the first header form a record.
+ *
+ * The file is split into chunks at record boundaries that are parsed in parallel in two passes: the
+ * first counts the output bytes of each chunk, and the second writes each chunk at its offset in the
+ * buffer, which is allocated once. The buffer has extra_capacity bytes of free capacity, so that an
+ * end symbol can be appended and the buffer given to the in-place index constructor without a copy.
+ */
+class Sequence_parser{
+
+private:
+
+    class Chunk{
+    public:
+        const uint8_t* begin;
+        const uint8_t* end;
+        int64_t length; // Bytes written by the chunk
+        bool has_header; // FASTA: the chunk contains a header
+        bool sequence_before_header; // FASTA: a sequence line precedes the first header of the chunk
+        bool pending_in, pending_out; // FASTA: the separator of a record is not yet written
+        int64_t offset; // In the output
+        Chunk() : begin(nullptr), end(nullptr), length(0), has_header(false), sequence_before_header(false),
+                  pending_in(false), pending_out(false), offset(0) {}
+    };
+
+    const uint8_t* data;
+    int64_t size;
+    uint8_t separator;
+
+    // Whitespace as in std::isspace in the C locale
+    static bool is_space(uint8_t c){ return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+    // Returns the line starting at p and moves p past its newline. Whitespace at the ends is removed.
+    static void next_line(const uint8_t*& p, const uint8_t* end, const uint8_t*& line_begin, const uint8_t*& line_end){
+        const uint8_t* newline = (const uint8_t*)std::memchr(p, '\n', end - p);
+        line_begin = p;
+        line_end = newline == nullptr ? end : newline;
+        p = newline == nullptr ? end : newline + 1;
+        while(line_begin < line_end && is_space(*line_begin)) line_begin++;
+        while(line_end > line_begin && is_space(line_end[-1])) line_end--;
+    }
+
+    // Without branches in the loop, so that the compiler vectorizes it
+    static void copy_upper_case(const uint8_t* begin, const uint8_t* end, uint8_t* out){
+        int64_t n = end - begin;
+        for(int64_t i = 0; i < n; i++){
+            uint8_t c = begin[i];
+            out[i] = c - 32 * ((uint8_t)(c - 'a') < 26);
+        }
+    }
+
+    // The first line start at or after position i
+    int64_t line_start(int64_t i) const{
+        if(i <= 0) return 0;
+        if(i >= size) return size;
+        const uint8_t* newline = (const uint8_t*)std::memchr(data + i - 1, '\n', size - i + 1);
+        return newline == nullptr ? size : newline + 1 - data;
+    }
+
+    // The first FASTQ record start at or after position i: a line starting with '@' such that the line
+    // after the next one starts with '+'. A quality line may start with '@', but then the line after
+    // the next one is a sequence.
+    int64_t fastq_record_start(int64_t i) const{
+        for(int64_t start = line_start(i); start < size; start = line_start(start + 1)){
+            if(data[start] != '@') continue;
+            int64_t plus = line_start(line_start(start + 1) + 1);
+            if(plus < size && data[plus] == '+') return start;
+        }
+        return size;
+    }
+
+    /*
+     * Runs the FASTA parser over the chunk starting in the state pending and writes to out if write is
+     * true. A separator is pending at the start of the file and after each header, and it is written
+     * before the next sequence line.
+     */
+    template<bool write>
+    void parse_fasta_chunk(Chunk& chunk, bool pending, uint8_t* out) const{
+        int64_t length = 0;
+        const uint8_t* p = chunk.begin;
+        const uint8_t* line_begin;
+        const uint8_t* line_end;
+        while(p < chunk.end){
+            next_line(p, chunk.end, line_begin, line_end);
+            if(line_begin == line_end) continue;
+            if(*line_begin == '>'){
+                chunk.has_header = true;
+                pending = true;
+                continue;
+            }
+            if(!chunk.has_header) chunk.sequence_before_header = true;
+            if(pending){
+                if(write) out[length] = separator;
+                length++;
+                pending = false;
+            }
+            if(write) copy_upper_case(line_begin, line_end, out + length);
+            length += line_end - line_begin;
+        }
+        chunk.length = length;
+        chunk.pending_out = pending;
+    }
+
+    // Records of four lines: the header, the sequence, the '+' line and the qualities
+    template<bool write>
+    void parse_fastq_chunk(Chunk& chunk, uint8_t* out) const{
+        int64_t length = 0;
+        const uint8_t* p = chunk.begin;
+        const uint8_t* line_begin;
+        const uint8_t* line_end;
+        const uint8_t* sequence_begin;
+        const uint8_t* sequence_end;
+        while(p < chunk.end){
+            next_line(p, chunk.end, line_begin, line_end);
+            if(line_begin == line_end) continue; // Empty lines between records
+            if(*line_begin != '@' || p == chunk.end)
+                throw std::runtime_error("Malformed FASTQ record at byte " + std::to_string(line_begin - data));
+            next_line(p, chunk.end, sequence_begin, sequence_end);
+            if(p == chunk.end) throw std::runtime_error("Malformed FASTQ record at byte " + std::to_string(line_begin - data));
+            const uint8_t* plus_line = p;
+            next_line(p, chunk.end, line_begin, line_end);
+            if(line_begin == line_end || *line_begin != '+')
+                throw std::runtime_error("Malformed FASTQ record at byte " + std::to_string(plus_line - data));
+            next_line(p, chunk.end, line_begin, line_end); // Qualities
+            if(sequence_begin == sequence_end) continue;
+            if(write){
+                out[length] = separator;
+                copy_upper_case(sequence_begin, sequence_end, out + length + 1);
+            }
+            length += 1 + (sequence_end - sequence_begin);
+        }
+        chunk.length = length;
+    }
+
+    // An exception in a thread is rethrown after all threads have finished
+    template<class t_function>
+    static void run_in_threads(std::vector<Chunk>& chunks, t_function f){
+        std::vector<std::exception_ptr> errors(chunks.size());
+        auto run = [&](int64_t i){
+            try{ f(chunks[i]); } catch(...){ errors[i] = std::current_exception(); }
+        };
+        std::vector<std::thread> threads;
+        for(int64_t i = 1; i < (int64_t)chunks.size(); i++) threads.emplace_back(run, i);
+        run(0);
+        for(std::thread& t : threads) t.join();
+        for(std::exception_ptr& e : errors) if(e) std::rethrow_exception(e);
+    }
+
+public:
+
+    int64_t min_chunk_size; // Smaller files are parsed with fewer threads
+
+    Sequence_parser(const uint8_t* data, int64_t size, uint8_t separator)
+        : data(data), size(size), separator(separator), min_chunk_size(1 << 20) {}
+
+    bool is_fastq() const{
+        int64_t i = 0;
+        while(i < size && is_space(data[i])) i++;
+        return i < size && data[i] == '@';
+    }
+
+    std::vector<uint8_t> parse(int64_t n_threads = std::thread::hardware_concurrency(), int64_t extra_capacity = 1) const{
+        int64_t n_chunks = std::max((int64_t)1, std::min(n_threads, size / min_chunk_size));
+        bool fastq = is_fastq();
+
+        std::vector<int64_t> starts(n_chunks + 1, size);
+        starts[0] = 0;
+        for(int64_t i = 1; i < n_chunks; i++){
+            int64_t target = std::max(starts[i - 1], size / n_chunks * i);
+            starts[i] = fastq ? fastq_record_start(target) : line_start(target);
+        }
+        std::vector<Chunk> chunks(n_chunks);
+        for(int64_t i = 0; i < n_chunks; i++){
+            chunks[i].begin = data + starts[i];
+            chunks[i].end = data + starts[i + 1];
+        }
+
+        // Count. A FASTA chunk is counted as if no separator was pending at its start.
+        if(fastq) run_in_threads(chunks, [this](Chunk& c){ parse_fastq_chunk<false>(c, nullptr); });
+        else run_in_threads(chunks, [this](Chunk& c){ parse_fasta_chunk<false>(c, false, nullptr); });
+
+        int64_t total = 0;
+        bool pending = true; // Before the first record of the file
+        for(Chunk& c : chunks){
+            if(!fastq){
+                c.pending_in = pending;
+                if(pending && c.sequence_before_header) c.length++;
+                pending = c.has_header ? c.pending_out : (pending && !c.sequence_before_header);
+            }
+            c.offset = total;
+            total += c.length;
+        }
+
+        std::vector<uint8_t> text;
+        text.reserve(total + extra_capacity);
+        text.resize(total);
+        uint8_t* out = text.data();
+        if(fastq) run_in_threads(chunks, [this, out](Chunk& c){ parse_fastq_chunk<true>(c, out + c.offset); });
+        else run_in_threads(chunks, [this, out](Chunk& c){ parse_fasta_chunk<true>(c, c.pending_in, out + c.offset); });
+        return text;
+    }
+};
+
+#endif
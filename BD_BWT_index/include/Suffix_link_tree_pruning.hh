@@ -0,0 +1,52 @@
+#ifndef SUFFIX_LINK_TREE_PRUNING_HH
+#define SUFFIX_LINK_TREE_PRUNING_HH
+
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+
+/*
+ * Rules that cut parts of the suffix link tree during the traversal, so that their rank queries are
+ * never made. A node is expanded only if its depth is less than max_depth and the label of the edge
+ * from its parent is not blocked: blocking '$' gives the stop_at_dollars rule, and blocking 'N' stops
+ * at the gaps of an assembly. Such nodes are in the tree without their children. A child that occurs
+ * fewer than min_count times is left out with its subtree, which occurs at most as often.
+ */
+class Suffix_link_tree_pruning{
+public:
+    int64_t max_depth; // The nodes at this depth are not expanded
+    int64_t min_count; // The children with smaller intervals are left out
+    bool blocked[256]; // The nodes below the edges with these labels are not expanded
+
+    Suffix_link_tree_pruning() : max_depth(std::numeric_limits<int64_t>::max()), min_count(1){
+        std::fill(blocked, blocked + 256, false);
+    }
+
+    void block(uint8_t c){ blocked[c] = true; }
+
+    // True if some rule can cut the tree
+    bool active() const{
+        return max_depth != std::numeric_limits<int64_t>::max() || min_count > 1 ||
+               std::find(blocked, blocked + 256, true) != blocked + 256;
+    }
+
+    // True if the children of the node at the given depth, below an edge with the given label, are searched
+    bool expands(int64_t depth, uint8_t extension) const{
+        return depth < max_depth && (depth == 0 || !blocked[extension]);
+    }
+
+    // True if a child with an interval of the given size is in the tree
+    bool keeps(int64_t count) const{
+        return count >= min_count;
+    }
+};
+
+// The default policy of traverse_suffix_link_tree. The tests are constants, so they are compiled away.
+class Suffix_link_tree_no_pruning{
+public:
+    bool active() const { return false; }
+    bool expands(int64_t depth, uint8_t extension) const { return true; }
+    bool keeps(int64_t count) const { return true; }
+};
+
+#endif
@@ -0,0 +1,98 @@
+#ifndef SUFFIX_LINK_TREE_STATISTICS_HH
+#define SUFFIX_LINK_TREE_STATISTICS_HH
+
+#include "Suffix_link_tree_traversal.hh"
+#include "Output_buffer.hh"
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <utility>
+
+/*
+ * Collects the distributions of the subtree sizes, the numbers of children and the interval sizes
+ * of the nodes at each depth of the suffix link tree during traverse_suffix_link_tree, without
+ * storing the tree. The traversal calls on_exit for a node after the on_exit of all its children,
+ * so the visitor keeps a counter for each node on the current path, indexed by depth, and adds the
+ * subtree size of a node to its parent when the node is exited. With stop_at_dollars, the nodes
+ * below an edge labelled with a dollar are not explored and count as leaves, as in the dot output.
+ */
+class Suffix_link_tree_statistics_visitor : public Suffix_link_tree_visitor{
+public:
+    typedef std::unordered_map<int64_t, int64_t> Histogram; // value -> number of nodes
+
+private:
+    std::vector<int64_t> path_subtree_sizes; // For the nodes on the current path, by depth
+    std::vector<int64_t> path_children;
+
+    void write_histograms(Output_buffer& out, const char* name, const std::vector<Histogram>& histograms) const{
+        for(int64_t depth = 0; depth < (int64_t)histograms.size(); depth++){
+            for(const std::pair<int64_t, int64_t>& bin : sorted(histograms[depth])){
+                out.write(name); out.put(' ');
+                out.write_int(depth); out.put(' ');
+                out.write_int(bin.first); out.put(' ');
+                out.write_int(bin.second); out.put('\n');
+            }
+        }
+    }
+
+public:
+    bool stop_at_dollars;
+    int64_t nodes;
+    std::vector<int64_t> depths; // Number of nodes at each depth
+    std::vector<Histogram> subtree_sizes, children, interval_sizes; // By depth
+
+    Suffix_link_tree_statistics_visitor(bool stop_at_dollars = false) : stop_at_dollars(stop_at_dollars), nodes(0) {}
+
+    bool on_enter(const Suffix_link_tree_node& v){
+        if(v.depth == (int64_t)depths.size()){ // The parent is on the path, so the depth grows by one at a time
+            path_subtree_sizes.push_back(0);
+            path_children.push_back(0);
+            depths.push_back(0);
+            subtree_sizes.emplace_back();
+            children.emplace_back();
+            interval_sizes.emplace_back();
+        }
+        path_subtree_sizes[v.depth] = 1;
+        path_children[v.depth] = 0;
+        depths[v.depth]++;
+        interval_sizes[v.depth][v.intervals.forward.size()]++;
+        nodes++;
+        return !(stop_at_dollars && v.depth > 0 && v.extension == '$');
+    }
+
+    void on_edge(const Suffix_link_tree_node& v, const Suffix_link_tree_node& child){
+        path_children[v.depth]++;
+    }
+
+    void on_exit(const Suffix_link_tree_node& v){
+        subtree_sizes[v.depth][path_subtree_sizes[v.depth]]++;
+        children[v.depth][path_children[v.depth]]++;
+        if(v.depth > 0) path_subtree_sizes[v.depth - 1] += path_subtree_sizes[v.depth];
+    }
+
+    // The bins of a histogram in increasing order of value
+    static std::vector<std::pair<int64_t, int64_t>> sorted(const Histogram& histogram){
+        std::vector<std::pair<int64_t, int64_t>> bins(histogram.begin(), histogram.end());
+        std::sort(bins.begin(), bins.end());
+        return bins;
+    }
+
+    /*
+     * Writes one line per nonempty bin, "name depth value count", in the order of depth and value:
+     * first "depth d nodes" for each depth, then the histograms named children, subtree_size and
+     * interval_size. The interval size of a node is the number of occurrences of its string.
+     */
+    void write(Output_buffer& out) const{
+        out.write("nodes "); out.write_int(nodes); out.put('\n');
+        for(int64_t depth = 0; depth < (int64_t)depths.size(); depth++){
+            out.write("depth "); out.write_int(depth); out.put(' ');
+            out.write_int(depths[depth]); out.put('\n');
+        }
+        write_histograms(out, "children", children);
+        write_histograms(out, "subtree_size", subtree_sizes);
+        write_histograms(out, "interval_size", interval_sizes);
+        out.flush();
+    }
+};
+
+#endif
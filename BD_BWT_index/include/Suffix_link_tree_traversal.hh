@@ -0,0 +1,238 @@
+#ifndef SUFFIX_LINK_TREE_TRAVERSAL_HH
+#define SUFFIX_LINK_TREE_TRAVERSAL_HH
+
+#include "BD_BWT_index.hh"
+#include "Output_buffer.hh"
+#include "Suffix_link_tree_pruning.hh"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <type_traits>
+#include <limits>
+#include <stdexcept>
+
+// A node of the suffix link tree as seen by a visitor
+class Suffix_link_tree_node{
+public:
+    Interval_pair intervals; // forward interval, reverse interval
+    int64_t depth; // depth in the suffix link tree
+    uint8_t extension; // the label on the arc between this node and its parent, 0 for the root
+    int64_t id; // the node id of the dot output
+    Suffix_link_tree_node(Interval_pair intervals, int64_t depth, uint8_t extension, int64_t id)
+        : intervals(intervals), depth(depth), extension(extension), id(id) {}
+    Suffix_link_tree_node(){}
+};
+
+/*
+ * A visitor that does nothing. Derive from it and hide the hooks that you need. The traversal
+ * calls the hooks of the derived type directly, so they can be inlined. If on_exit is not hidden,
+ * the traversal does not keep the nodes of the current path on its stack.
+ */
+class Suffix_link_tree_visitor{
+public:
+    // Called when the traversal reaches v. Return false to skip the children of v.
+    bool on_enter(const Suffix_link_tree_node& v) { return true; }
+    // Called for each child of v after on_enter(v), in the order of the alphabet
+    void on_edge(const Suffix_link_tree_node& v, const Suffix_link_tree_node& child) {}
+    // Called after the whole subtree of v has been visited
+    void on_exit(const Suffix_link_tree_node& v) {}
+};
+
+class Suffix_link_tree_traversal_stats{
+public:
+    int64_t nodes; // Number of nodes entered
+    int64_t max_stack_frames; // The largest number of frames on the stack at once
+    int64_t frame_bytes; // Size of one frame
+    Suffix_link_tree_traversal_stats() : nodes(0), max_stack_frames(0), frame_bytes(0) {}
+};
+
+// True if t_visitor has its own on_exit. Otherwise the traversal keeps no frames for on_exit.
+template<class t_visitor>
+class Suffix_link_tree_visitor_has_on_exit{
+public:
+    static const bool value = !std::is_same<decltype(&t_visitor::on_exit),
+        void (Suffix_link_tree_visitor::*)(const Suffix_link_tree_node&)>::value;
+};
+
+/*
+ * A frame of the stack of traverse_suffix_link_tree. The forward and reverse intervals of a node
+ * have the same size, so the frame stores their left ends and the size, in integers of type t_int.
+ * With 32-bit integers a frame takes 24 bytes instead of 48.
+ */
+template<class t_int>
+class Suffix_link_tree_frame{
+public:
+    t_int forward_left, reverse_left, size;
+    t_int depth;
+    t_int id;
+    uint8_t extension;
+    bool exit; // Call on_exit for the node instead of entering it
+
+    Suffix_link_tree_frame(const Suffix_link_tree_node& v, bool exit)
+        : forward_left(v.intervals.forward.left), reverse_left(v.intervals.reverse.left), size(v.intervals.forward.size()),
+          depth(v.depth), id(v.id), extension(v.extension), exit(exit) {}
+
+    Suffix_link_tree_node node() const{
+        int64_t n = size;
+        return Suffix_link_tree_node(Interval_pair(forward_left, forward_left + n - 1, reverse_left, reverse_left + n - 1),
+                                     depth, extension, id);
+    }
+};
+
+/*
+ * An extension of a node on the stack of traverse_suffix_link_tree. The reverse intervals of the
+ * extensions of a node are consecutive in the order of the alphabet, so they are not stored.
+ */
+template<class t_int>
+class Suffix_link_tree_extension{
+public:
+    t_int forward_left, size;
+    uint8_t symbol;
+};
+
+/*
+ * Traverses the suffix link tree of the index depth-first, calling the hooks of the visitor.
+ * Does no output itself. By default the order and the node ids are the same as with
+ * BD_BWT_index_iterator: the children are pushed to the stack in the order of the alphabet.
+ *
+ * With smallest_first, the children of every node are visited in increasing order of their
+ * interval sizes, so the largest child comes last. Every child that waits on the stack while its
+ * sibling is visited has at most half the interval of its parent, so the stack holds O(sigma log n)
+ * frames, where sigma is the alphabet size. In the default order it can grow linearly in the
+ * length of the text. If the visitor has on_exit, the stack also holds one frame for every node
+ * on the current path. The edges from a node are numbered in the order of the alphabet in both
+ * orders, but the ids of the deeper nodes differ.
+ *
+ * The pruning policy cuts the tree during the search: the children of a node are searched only if
+ * pruning.expands(depth, extension), and a child is in the tree only if pruning.keeps(interval size).
+ * Suffix_link_tree_pruning has the rules of slt_to_dot. The default policy keeps everything.
+ *
+ * The children of a node are found in batches: when the children are pushed, their extensions are
+ * computed together with left_extensions_batch, and when a node is popped, the right-maximality of
+ * its extensions is tested together with is_right_maximal_batch. The rank queries of the siblings
+ * descend the wavelet trees one level at a time, so that their cache misses overlap. The extensions
+ * wait on a second stack in the order of the frames, one entry per extension of a node on the stack.
+ *
+ * The stacks store the positions, depths and ids in integers of type t_int, e.g.
+ * traverse_suffix_link_tree<uint32_t>(index, visitor) for texts shorter than 2^31. The tree has
+ * fewer than 2n nodes. Throws std::runtime_error if that does not fit into t_int.
+ */
+template<class t_int = int64_t, class t_bitvector, class t_bwt, class t_visitor, class t_pruning = Suffix_link_tree_no_pruning>
+Suffix_link_tree_traversal_stats traverse_suffix_link_tree(const BD_BWT_index<t_bitvector, t_bwt>& index, t_visitor& visitor,
+                                                           bool smallest_first = false, const t_pruning& pruning = t_pruning()){
+    typedef Suffix_link_tree_frame<t_int> Stack_frame;
+    typedef Suffix_link_tree_extension<t_int> Extension;
+    const bool has_on_exit = Suffix_link_tree_visitor_has_on_exit<t_visitor>::value;
+    if(2 * (uint64_t)index.size() > (uint64_t)std::numeric_limits<t_int>::max())
+        throw std::runtime_error("The text is too long for the integer type of the suffix link tree traversal");
+
+    Suffix_link_tree_traversal_stats stats;
+    stats.frame_bytes = sizeof(Stack_frame);
+    std::vector<Stack_frame> stack;
+    std::vector<Extension> extensions; // Of the nodes on the stack, those of the top node last
+    std::vector<int64_t> extensions_begin; // The first extension of each node on the stack
+    BD_BWT_index_batch_extensions batch;
+    std::vector<Interval_pair> requests, candidates;
+    std::vector<uint8_t> candidate_symbols;
+    std::vector<bool> maximal;
+
+    // Computes the extensions of the nodes in stack[first..], which are not expanded yet
+    auto push_extensions = [&](int64_t first){
+        requests.clear();
+        for(int64_t i = first; i < (int64_t)stack.size(); i++){
+            const Stack_frame& f = stack[i];
+            requests.push_back(pruning.expands(f.depth, f.extension) ? f.node().intervals : Interval_pair(0,-1,0,-1));
+        }
+        index.left_extensions_batch(requests.data(), requests.size(), batch);
+        for(int64_t k = 0; k < (int64_t)requests.size(); k++){
+            extensions_begin.push_back(extensions.size());
+            for(int64_t i = batch.begin[k]; i < batch.begin[k+1]; i++)
+                extensions.push_back({(t_int)batch.intervals[i].forward.left, (t_int)batch.intervals[i].forward.size(), batch.symbols[i]});
+        }
+    };
+
+    int64_t next_id = 1;
+    Interval empty_string(0, index.size()-1);
+    stack.push_back(Stack_frame(Suffix_link_tree_node(Interval_pair(empty_string, empty_string), 0, 0, 0), false));
+    push_extensions(0);
+
+    while(!stack.empty()){
+        stats.max_stack_frames = std::max(stats.max_stack_frames, (int64_t)stack.size());
+        Stack_frame f = stack.back(); stack.pop_back();
+        Suffix_link_tree_node v = f.node();
+        if(has_on_exit && f.exit){
+            visitor.on_exit(v);
+            continue;
+        }
+        stats.nodes++;
+        if(has_on_exit) stack.push_back(Stack_frame(v, true));
+        int64_t begin = extensions_begin.back();
+        extensions_begin.pop_back();
+        bool expand = visitor.on_enter(v) && pruning.expands(v.depth, v.extension);
+        candidates.clear();
+        candidate_symbols.clear();
+        int64_t reverse_left = v.intervals.reverse.left;
+        for(int64_t i = begin; expand && i < (int64_t)extensions.size(); i++){ // In the order of the alphabet
+            const Extension& e = extensions[i];
+            int64_t size = e.size;
+            Interval_pair child(e.forward_left, e.forward_left + size - 1, reverse_left, reverse_left + size - 1);
+            reverse_left += size;
+            if(e.symbol == BD_BWT_index<t_bitvector, t_bwt>::END) continue;
+            if(!pruning.keeps(size)) continue;
+            candidates.push_back(child);
+            candidate_symbols.push_back(e.symbol);
+        }
+        extensions.resize(begin);
+        if(!expand) continue;
+
+        int64_t first_child = stack.size();
+        index.is_right_maximal_batch(candidates.data(), candidates.size(), maximal);
+        for(int64_t i = 0; i < (int64_t)candidates.size(); i++){
+            if(!maximal[i]) continue;
+            Suffix_link_tree_node child(candidates[i], v.depth + 1, candidate_symbols[i], next_id++);
+            visitor.on_edge(v, child);
+            stack.push_back(Stack_frame(child, false));
+        }
+        if(smallest_first){ // The smallest interval on top
+            std::stable_sort(stack.begin() + first_child, stack.end(), [](const Stack_frame& a, const Stack_frame& b){
+                return a.size > b.size;
+            });
+        }
+        push_extensions(first_child);
+    }
+    return stats;
+}
+
+/*
+ * Prints the edges in dot format like BD_BWT_index_iterator. With stop_at_dollars, the children of
+ * the nodes below an edge labelled with a dollar are skipped. In debug mode the nodes are labelled
+ * with their strings.
+ */
+class Dot_visitor : public Suffix_link_tree_visitor{
+public:
+    Output_buffer& output;
+    bool debug_mode;
+    bool stop_at_dollars;
+    std::string label; // The string on the path from the root to the current node, only in debug mode
+
+    Dot_visitor(Output_buffer& output, bool debug_mode = false, bool stop_at_dollars = false)
+        : output(output), debug_mode(debug_mode), stop_at_dollars(stop_at_dollars) {}
+
+    bool on_enter(const Suffix_link_tree_node& v){
+        if(debug_mode && v.depth > 0){
+            label.resize(v.depth - 1);
+            label.push_back(v.extension);
+        }
+        return !(stop_at_dollars && v.depth > 0 && v.extension == '$');
+    }
+
+    void on_edge(const Suffix_link_tree_node& v, const Suffix_link_tree_node& child){
+        if(debug_mode){
+            std::string label_rev(label.rbegin(), label.rend());
+            output.write("\"" + label_rev + "\" -> \"" + (char)child.extension + label_rev + "\" [label=\"" + (char)child.extension + "\"];\n");
+        }
+        else output.write_edge(v.id, child.id, child.extension);
+    }
+};
+
+#endif
@@ -3,6 +3,8 @@
 
 #include <string>
 
-uint8_t* bwt_dbwt(uint8_t* text, int64_t length, uint8_t end_char);
+// Computes the BWT of text[0..length-1] with dbwt. Safe to call from several threads at once.
+// If peak_memory is not null, the peak number of bytes allocated by dbwt during the call is stored there.
+uint8_t* bwt_dbwt(uint8_t* text, int64_t length, uint8_t end_char, int64_t* peak_memory = nullptr);
 
 #endif
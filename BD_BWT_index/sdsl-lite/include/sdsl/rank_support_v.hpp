@@ -123,6 +123,12 @@ class rank_support_v : public rank_support
                 return  *p + ((*(p+1)>>(63 - 9*((idx&0x1FF)>>6)))&0x1FF);
         }
 
+        //! Starts loading the memory that rank(idx) reads into the cache.
+        void prefetch(size_type idx) const {
+            __builtin_prefetch(m_basic_block.data() + ((idx>>8)&0xFFFFFFFFFFFFFFFEULL));
+            __builtin_prefetch(m_v->data() + (idx>>6));
+        }
+
         inline size_type operator()(size_type idx)const {
             return rank(idx);
         }
@@ -187,6 +187,7 @@ class wt_pc
 
         const size_type&       sigma = m_sigma;
         const bit_vector_type& bv  = m_bv;
+        const rank_1_type&     bv_rank = m_bv_rank;
 
         // Default constructor
         wt_pc() {};
@@ -846,6 +847,18 @@ class wt_pc
             return {path_len,path};
         }
 
+        //! Returns the start of the bit vector of inner node v in bv.
+        size_type bv_pos(const node_type& v) const
+        {
+            return m_tree.bv_pos(v);
+        }
+
+        //! Returns the number of ones in bv before the bit vector of inner node v.
+        size_type bv_pos_rank(const node_type& v) const
+        {
+            return m_tree.bv_pos_rank(v);
+        }
+
         //! Returns for a symbol c the next larger or equal symbol in the WT.
         /*! \param c the symbol
          *  \return A pair. The first element of the pair consititues if
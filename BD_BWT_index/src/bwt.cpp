@@ -10,11 +10,13 @@ extern "C" {
 
 using namespace std;
 
-uint8_t* bwt_dbwt(uint8_t* text, int64_t length, uint8_t end_char){
+uint8_t* bwt_dbwt(uint8_t* text, int64_t length, uint8_t end_char, int64_t* peak_memory){
 
-    unsigned int last;
+    unsigned long last;
     int64_t n = length;
+    dbwt_reset_peak_alloc();
     uint8_t* d = dbwt_bwt(text, n, &last, 0);
+    if(peak_memory != nullptr) *peak_memory = dbwt_peak_alloc();
     d = (uint8_t*)realloc(d, (n + 2) * sizeof(uint8_t));
     d[last] = end_char;
     d[n + 1] = 0;
@@ -2,8 +2,25 @@
 #include <string>
 #include "BD_BWT_index.hh"
 #include "Iterators.hh"
+#include "Parallel_traversal.hh"
+#include "Level_order_traversal.hh"
+#include "Binary_edge_list.hh"
+#include "BP_suffix_link_tree.hh"
+#include "Suffix_link_tree_traversal.hh"
+#include "Suffix_link_tree_statistics.hh"
+#include "Input_file.hh"
+#include "Sequence_parser.hh"
 #include <cassert>
 #include <set>
+#include <map>
+#include <sstream>
+#include <cstdio>
+#include <cinttypes>
+#include <algorithm>
+#include <thread>
+#include <atomic>
+#include <random>
+#include <limits>
 
 using namespace std;
 
@@ -56,8 +73,9 @@ vector<string> all_binary_strings_up_to(int k){
 }
 
 
-bool test_suffix_link_tree_iteration(const BD_BWT_index<sdsl::bit_vector>& index, string& s){
-    BD_BWT_index_iterator<sdsl::bit_vector> it(&index);
+template<class t_bitvector, class t_bwt>
+bool test_suffix_link_tree_iteration(const BD_BWT_index<t_bitvector, t_bwt>& index, string& s){
+    BD_BWT_index_iterator<t_bitvector, t_bwt> it(&index);
     set<string> labels;
     while(it.next()){
         string x(it.label.rbegin(), it.label.rend());
@@ -93,6 +111,849 @@ bool test_forward_step(const BD_BWT_index<sdsl::bit_vector>& index, const string
     return true;
 }
 
+// Compares left_extensions, right_extensions, left_extend_batch and right_extend_batch to
+// left_extend and right_extend at every node of the suffix link tree
+template<class t_bitvector, class t_bwt>
+bool test_extensions(const BD_BWT_index<t_bitvector, t_bwt>& index){
+    BD_BWT_index_iterator<t_bitvector, t_bwt> it(&index);
+    BD_BWT_index_extensions extensions;
+    vector<int64_t> local_c_array(256);
+    vector<Interval_pair> requests;
+    vector<uint8_t> request_symbols;
+    while(it.next()){
+        Interval_pair I = it.current.intervals;
+        for(uint8_t c : index.get_alphabet()){
+            requests.push_back(I);
+            request_symbols.push_back(c);
+        }
+        for(uint8_t c : {0x00, 0xff}){ // Outside of the alphabet, except 0x00 in test_zero_bytes
+            requests.push_back(I);
+            request_symbols.push_back(c);
+        }
+        for(bool left : {true, false}){
+            if(left){
+                index.left_extensions(I, extensions);
+                index.compute_local_c_array_forward(I.forward, local_c_array);
+            } else{
+                index.right_extensions(I, extensions);
+                index.compute_local_c_array_reverse(I.reverse, local_c_array);
+            }
+            int64_t i = 0;
+            for(uint8_t c : index.get_alphabet()){
+                Interval_pair expected = left ? index.left_extend(I, c, local_c_array) : index.right_extend(I, c, local_c_array);
+                if(expected.forward.size() == 0) continue;
+                if(i == extensions.count || extensions.symbols[i] != c || extensions.intervals[i] != expected) return false;
+                i++;
+            }
+            if(i != extensions.count) return false;
+        }
+        index.right_extensions(I, extensions);
+        if(index.is_right_maximal(I) != (extensions.count >= 2)) return false;
+        index.left_extensions(I, extensions);
+        if(index.is_left_maximal(I) != (extensions.count >= 2)) return false;
+    }
+    
+    int64_t n = requests.size();
+    vector<Interval_pair> left(n), right(n);
+    index.left_extend_batch(requests.data(), request_symbols.data(), n, left.data());
+    index.right_extend_batch(requests.data(), request_symbols.data(), n, right.data());
+    for(int64_t k = 0; k < n; k++){
+        if(left[k] != index.left_extend(requests[k], request_symbols[k])) return false;
+        if(right[k] != index.right_extend(requests[k], request_symbols[k])) return false;
+    }
+    
+    // Every node and its extensions, with the empty interval among them
+    vector<Interval_pair> nodes;
+    for(const Interval_pair& I : requests) if(nodes.empty() || nodes.back() != I) nodes.push_back(I);
+    for(int64_t k = 0; k < n; k++) nodes.push_back(left[k]);
+    BD_BWT_index_batch_extensions batch;
+    vector<bool> right_maximal, left_maximal;
+    index.is_right_maximal_batch(nodes.data(), nodes.size(), right_maximal);
+    index.is_left_maximal_batch(nodes.data(), nodes.size(), left_maximal);
+    for(bool left_side : {true, false}){
+        if(left_side) index.left_extensions_batch(nodes.data(), nodes.size(), batch);
+        else index.right_extensions_batch(nodes.data(), nodes.size(), batch);
+        if((int64_t)batch.begin.size() != (int64_t)nodes.size() + 1) return false;
+        for(int64_t k = 0; k < (int64_t)nodes.size(); k++){
+            if(left_side) index.left_extensions(nodes[k], extensions);
+            else index.right_extensions(nodes[k], extensions);
+            if(nodes[k].forward.size() == 0) extensions.count = 0;
+            if(batch.begin[k+1] - batch.begin[k] != extensions.count) return false;
+            for(int64_t i = 0; i < extensions.count; i++){
+                if(batch.symbols[batch.begin[k] + i] != extensions.symbols[i]) return false;
+                if(batch.intervals[batch.begin[k] + i] != extensions.intervals[i]) return false;
+            }
+        }
+    }
+    for(int64_t k = 0; k < (int64_t)nodes.size(); k++){
+        if(right_maximal[k] != index.is_right_maximal(nodes[k])) return false;
+        if(left_maximal[k] != index.is_left_maximal(nodes[k])) return false;
+    }
+    return true;
+}
+
+// Queries one index from many threads at once with the functions that use no caller-owned space,
+// and compares the answers to ones computed beforehand in one thread with caller-owned space
+bool test_concurrent_queries(){
+    std::mt19937 rng(1234);
+    string s;
+    for(int64_t i = 0; i < 20000; i++) s += "acgt$"[rng() % 5];
+    BD_BWT_index<> index((const uint8_t*)s.c_str());
+    const vector<uint8_t>& alphabet = index.get_alphabet();
+    
+    // Collect the nodes of the suffix link tree with the extensions of every node by every character
+    vector<Interval_pair> nodes;
+    vector<Interval_pair> expected_left, expected_right; // alphabet.size() per node
+    vector<bool> expected_right_maximal, expected_left_maximal;
+    BD_BWT_index_extensions children;
+    vector<int64_t> local_c_array(256);
+    vector<Interval_pair> stack = {Interval_pair(0, index.size()-1, 0, index.size()-1)};
+    while(!stack.empty()){
+        Interval_pair I = stack.back(); stack.pop_back();
+        nodes.push_back(I);
+        index.compute_local_c_array_forward(I.forward, local_c_array);
+        for(uint8_t c : alphabet) expected_left.push_back(index.left_extend(I, c, local_c_array));
+        index.compute_local_c_array_reverse(I.reverse, local_c_array);
+        for(uint8_t c : alphabet) expected_right.push_back(index.right_extend(I, c, local_c_array));
+        index.right_extensions(I, children);
+        expected_right_maximal.push_back(children.count >= 2);
+        index.left_extensions(I, children);
+        expected_left_maximal.push_back(children.count >= 2);
+        for(int64_t i = 0; i < children.count; i++){
+            if(children.symbols[i] != BD_BWT_index<>::END && index.is_right_maximal(children.intervals[i]))
+                stack.push_back(children.intervals[i]);
+        }
+    }
+    
+    std::atomic<bool> ok(true);
+    int64_t n_threads = 8;
+    vector<std::thread> threads;
+    for(int64_t t = 0; t < n_threads; t++){
+        threads.push_back(std::thread([&, t](){
+            BD_BWT_index_extensions extensions;
+            for(int64_t round = 0; round < 2; round++){
+                for(int64_t k = 0; k < (int64_t)nodes.size() && ok; k++){
+                    int64_t v = (k + t * nodes.size() / n_threads) % nodes.size(); // Threads start at different nodes
+                    Interval_pair I = nodes[v];
+                    index.left_extensions(I, extensions);
+                    int64_t j = 0; // Index in extensions
+                    for(int64_t i = 0; i < (int64_t)alphabet.size(); i++){
+                        Interval_pair left = expected_left[v * alphabet.size() + i];
+                        if(index.left_extend(I, alphabet[i]) != left) ok = false;
+                        if(index.right_extend(I, alphabet[i]) != expected_right[v * alphabet.size() + i]) ok = false;
+                        if(left.forward.size() > 0 && (j >= extensions.count || extensions.intervals[j++] != left)) ok = false;
+                    }
+                    if(j != extensions.count) ok = false;
+                    if(index.is_right_maximal(I) != expected_right_maximal[v]) ok = false;
+                    if(index.is_left_maximal(I) != expected_left_maximal[v]) ok = false;
+                }
+            }
+        }));
+    }
+    for(std::thread& thread : threads) thread.join();
+    return ok;
+}
+
+// The output of BD_BWT_index_iterator, which prints to cout
+string iterator_output(const BD_BWT_index<>& index, bool debug_mode, bool stop_at_dollars){
+    stringstream out;
+    streambuf* cout_buf = cout.rdbuf(out.rdbuf());
+    BD_BWT_index_iterator<sdsl::bit_vector> it(&index, debug_mode);
+    it.stop_at_dollars = stop_at_dollars;
+    while(it.next());
+    cout.rdbuf(cout_buf);
+    return out.str();
+}
+
+// Compares the output of the parallel traversal with different numbers of threads to the iterator
+bool test_parallel_traversal(const BD_BWT_index<>& index){
+    for(bool debug_mode : {false, true}){
+        for(bool stop_at_dollars : {false, true}){
+            string expected = iterator_output(index, debug_mode, stop_at_dollars);
+            for(int64_t threads : {1, 2, 4, 8}){
+                for(int64_t max_buffered_edges : {1 << 20, 1}){ // With 1, the workers wait for the printer all the time
+                    BD_BWT_index_parallel_traversal<sdsl::bit_vector> traversal(&index, threads, debug_mode);
+                    traversal.stop_at_dollars = stop_at_dollars;
+                    traversal.max_buffered_edges = max_buffered_edges;
+                    stringstream out;
+                    int64_t nodes = traversal.print(out);
+                    if(out.str() != expected) return false;
+                    if(nodes != count(expected.begin(), expected.end(), '\n') + 1) return false;
+                }
+            }
+        }
+    }
+
+    // A failing output stops the workers, and print throws instead of waiting for them
+    int fd = open("/dev/null", O_RDONLY);
+    try{
+        Output_buffer out(fd, 16);
+        BD_BWT_index_parallel_traversal<sdsl::bit_vector> traversal(&index, 4);
+        traversal.max_buffered_edges = 1;
+        traversal.print(out);
+        if(index.size() > 2) return false; // Something was written
+    } catch(std::runtime_error& e){}
+    close(fd);
+    return true;
+}
+
+// The output of the dot visitor
+string dot_visitor_output(const BD_BWT_index<>& index, bool debug_mode, bool stop_at_dollars, bool smallest_first){
+    stringstream out;
+    {
+        Output_buffer buffer(out);
+        Dot_visitor dot(buffer, debug_mode, stop_at_dollars);
+        traverse_suffix_link_tree(index, dot, smallest_first);
+    }
+    return out.str();
+}
+
+// Records the nodes in the order of the hooks and checks that the hooks nest
+class Recording_visitor : public Suffix_link_tree_visitor{
+public:
+    vector<Suffix_link_tree_node> entered;
+    vector<int64_t> path; // Ids of the entered nodes that have not been exited
+    vector<int64_t> last_child; // The id of the last child given to on_edge for each node on the path
+    bool ok = true;
+    bool on_enter(const Suffix_link_tree_node& v){
+        if((int64_t)path.size() != v.depth) ok = false;
+        entered.push_back(v);
+        path.push_back(v.id);
+        last_child.push_back(0);
+        return true;
+    }
+    void on_edge(const Suffix_link_tree_node& v, const Suffix_link_tree_node& child){
+        if(path.empty() || v.id != path.back() || child.depth != v.depth + 1 || child.id <= last_child.back()) ok = false;
+        last_child.back() = child.id;
+    }
+    void on_exit(const Suffix_link_tree_node& v){
+        if(path.empty() || path.back() != v.id) ok = false;
+        path.pop_back();
+        last_child.pop_back();
+    }
+};
+
+// Compares the dot visitor to the iterator, and the nodes and the nesting of the hooks of
+// the visitor traversal to the nodes of the iterator
+bool test_visitor_traversal(const BD_BWT_index<>& index){
+    for(bool debug_mode : {false, true}){
+        for(bool stop_at_dollars : {false, true}){
+            string expected = iterator_output(index, debug_mode, stop_at_dollars);
+            if(dot_visitor_output(index, debug_mode, stop_at_dollars, false) != expected) return false;
+            stringstream out;
+            {
+                Output_buffer buffer(out);
+                Dot_visitor dot(buffer, debug_mode, stop_at_dollars);
+                traverse_suffix_link_tree<uint32_t>(index, dot);
+            }
+            if(out.str() != expected) return false;
+        }
+    }
+    if(index.size() > 127){
+        Suffix_link_tree_visitor nothing;
+        try{
+            traverse_suffix_link_tree<uint8_t>(index, nothing);
+            return false;
+        } catch(std::runtime_error& e){} // The tree may have more nodes than 8 bits can count
+    }
+
+    Recording_visitor recorder;
+    traverse_suffix_link_tree(index, recorder);
+    if(!recorder.ok || !recorder.path.empty()) return false;
+    BD_BWT_index_iterator<sdsl::bit_vector> it(&index);
+    it.print_edges = false;
+    int64_t k = 0;
+    while(it.next()){
+        if(k == (int64_t)recorder.entered.size()) return false;
+        const Suffix_link_tree_node& v = recorder.entered[k++];
+        if(v.intervals != it.current.intervals || v.depth != it.current.depth) return false;
+        if(v.id != it.current.node_id || (v.depth > 0 && v.extension != it.current.extension)) return false;
+    }
+    return k == (int64_t)recorder.entered.size();
+}
+
+// Checks that smallest-first traversal visits the same nodes as the traversal in the order of the
+// alphabet, that the iterator and the parallel traversal agree with it, and the bound on the stack
+bool test_smallest_first(const BD_BWT_index<>& index){
+    vector<vector<int64_t>> nodes[2];
+    for(bool smallest_first : {false, true}){
+        Recording_visitor recorder;
+        traverse_suffix_link_tree(index, recorder, smallest_first);
+        if(!recorder.ok) return false;
+        for(const Suffix_link_tree_node& v : recorder.entered)
+            nodes[smallest_first].push_back({v.intervals.forward.left, v.intervals.forward.right, v.intervals.reverse.left, v.depth, v.extension});
+        sort(nodes[smallest_first].begin(), nodes[smallest_first].end());
+    }
+    if(nodes[0] != nodes[1]) return false;
+
+    for(bool debug_mode : {false, true}){
+        for(bool stop_at_dollars : {false, true}){
+            string expected = dot_visitor_output(index, debug_mode, stop_at_dollars, true);
+            stringstream out;
+            streambuf* cout_buf = cout.rdbuf(out.rdbuf());
+            {
+                BD_BWT_index_iterator<sdsl::bit_vector> it(&index, debug_mode);
+                it.stop_at_dollars = stop_at_dollars;
+                it.smallest_first = true;
+                while(it.next());
+            }
+            cout.rdbuf(cout_buf);
+            if(out.str() != expected) return false;
+            for(int64_t threads : {1, 3}){
+                BD_BWT_index_parallel_traversal<sdsl::bit_vector> traversal(&index, threads, debug_mode);
+                traversal.stop_at_dollars = stop_at_dollars;
+                traversal.smallest_first = true;
+                stringstream parallel_out;
+                traversal.print(parallel_out);
+                if(parallel_out.str() != expected) return false;
+            }
+        }
+    }
+
+    Suffix_link_tree_visitor nothing;
+    Suffix_link_tree_traversal_stats stats = traverse_suffix_link_tree(index, nothing, true);
+    int64_t log_n = 0;
+    while(((int64_t)1 << log_n) < index.size()) log_n++;
+    return stats.nodes == (int64_t)nodes[1].size() && stats.max_stack_frames <= (int64_t)index.get_alphabet().size() * (log_n + 1) + 1;
+}
+
+// The strings of the nodes of a tree in dot format with numbered nodes, sorted. Returns an empty
+// vector if the child of the i-th edge is not node i.
+vector<string> dot_node_strings(const string& dot){
+    vector<string> strings(1, "");
+    stringstream in(dot);
+    string line;
+    while(getline(in, line)){
+        int64_t from, to;
+        char c;
+        if(sscanf(line.c_str(), "%" SCNd64 " -> %" SCNd64 " [label=\"%c", &from, &to, &c) != 3) return vector<string>();
+        if(to != (int64_t)strings.size() || from >= to) return vector<string>();
+        strings.push_back(c + strings[from]);
+    }
+    sort(strings.begin(), strings.end());
+    return strings;
+}
+
+// Checks that the level order traversal prints the same tree as the iterator with any number of threads
+bool test_level_order_traversal(const BD_BWT_index<>& index){
+    for(bool stop_at_dollars : {false, true}){
+        vector<string> expected = dot_node_strings(iterator_output(index, false, stop_at_dollars));
+        if(expected.empty()) return false;
+        string first_output;
+        for(int64_t threads : {1, 2, 5}){
+            BD_BWT_index_level_order_traversal<sdsl::bit_vector> traversal(&index, threads);
+            traversal.stop_at_dollars = stop_at_dollars;
+            stringstream out;
+            int64_t nodes = traversal.print(out);
+            if(threads == 1) first_output = out.str();
+            else if(out.str() != first_output) return false;
+            if(nodes != (int64_t)expected.size() || dot_node_strings(out.str()) != expected) return false;
+        }
+    }
+    return true;
+}
+
+// Occurrences of t in s, overlapping
+int64_t count_occurrences(const string& s, const string& t){
+    int64_t count = 0;
+    for(int64_t i = 0; i + t.size() <= s.size(); i++) count += s.compare(i, t.size(), t) == 0;
+    return count;
+}
+
+// Checks that every traversal prunes the tree to the nodes whose parents are expanded and that occur
+// often enough, computed from the strings of the nodes of the full tree and their occurrences in s
+bool test_pruning(const BD_BWT_index<>& index, const string& s){
+    vector<string> full = dot_node_strings(iterator_output(index, false, false));
+    if(full.empty()) return false;
+    stable_sort(full.begin(), full.end(), [](const string& a, const string& b){ return a.size() < b.size(); });
+    vector<int64_t> counts;
+    for(const string& w : full) counts.push_back(count_occurrences(s, w));
+    for(int64_t max_depth : {(int64_t)0, (int64_t)1, (int64_t)3, numeric_limits<int64_t>::max()}){
+        for(int64_t min_count : {1, 2, 3}){
+            for(string blocked : {"", "a", "b$"}){
+                Suffix_link_tree_pruning pruning;
+                pruning.max_depth = max_depth;
+                pruning.min_count = min_count;
+                for(char c : blocked) pruning.block(c);
+
+                // The full tree has the suffix of every node without its first character
+                set<string> kept;
+                vector<string> expected;
+                for(int64_t v = 0; v < (int64_t)full.size(); v++){ // The parents are shorter, so they come first
+                    const string& w = full[v];
+                    string parent = w.substr(min((size_t)1, w.size()));
+                    bool in_tree = w == "" || (kept.count(parent) && pruning.expands(parent.size(), parent[0]) &&
+                                               pruning.keeps(counts[v]));
+                    if(in_tree){
+                        kept.insert(w);
+                        expected.push_back(w);
+                    }
+                }
+                sort(expected.begin(), expected.end());
+
+                for(bool smallest_first : {false, true}){
+                    stringstream out;
+                    {
+                        Output_buffer buffer(out);
+                        Dot_visitor visitor(buffer);
+                        traverse_suffix_link_tree(index, visitor, smallest_first, pruning);
+                    }
+                    if(dot_node_strings(out.str()) != expected) return false;
+                }
+                stringstream iterator_out;
+                {
+                    Output_buffer buffer(iterator_out);
+                    BD_BWT_index_iterator<sdsl::bit_vector> it(&index, false, &buffer);
+                    it.pruning = pruning;
+                    while(it.next());
+                }
+                if(dot_node_strings(iterator_out.str()) != expected) return false;
+                for(int64_t threads : {1, 3}){
+                    BD_BWT_index_parallel_traversal<sdsl::bit_vector> parallel(&index, threads);
+                    parallel.pruning = pruning;
+                    stringstream parallel_out;
+                    if(parallel.print(parallel_out) != (int64_t)expected.size()) return false;
+                    if(dot_node_strings(parallel_out.str()) != expected) return false;
+                    BD_BWT_index_level_order_traversal<sdsl::bit_vector> level_order(&index, threads);
+                    level_order.pruning = pruning;
+                    stringstream level_order_out;
+                    if(level_order.print(level_order_out) != (int64_t)expected.size()) return false;
+                    if(dot_node_strings(level_order_out.str()) != expected) return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+// Compares the histograms of the statistics visitor to histograms computed from the dot output of the
+// iterator and the occurrences of the node strings in s
+bool test_suffix_link_tree_statistics(const BD_BWT_index<>& index, const string& s){
+    typedef vector<map<int64_t, int64_t>> Histograms;
+    for(bool stop_at_dollars : {false, true}){
+        vector<int64_t> parent(1, -1), depth(1, 0);
+        vector<string> strings(1, "");
+        stringstream dot(iterator_output(index, false, stop_at_dollars));
+        string line;
+        while(getline(dot, line)){
+            int64_t from, to;
+            char c;
+            if(sscanf(line.c_str(), "%" SCNd64 " -> %" SCNd64 " [label=\"%c", &from, &to, &c) != 3) continue;
+            if(to != (int64_t)parent.size()) return false;
+            parent.push_back(from);
+            depth.push_back(depth[from] + 1);
+            strings.push_back(c + strings[from]);
+        }
+        int64_t n_nodes = parent.size();
+        int64_t max_depth = *max_element(depth.begin(), depth.end());
+        vector<int64_t> subtree_size(n_nodes, 1), n_children(n_nodes, 0);
+        for(int64_t v = n_nodes - 1; v > 0; v--){ // The parent of a node has a smaller id
+            subtree_size[parent[v]] += subtree_size[v];
+            n_children[parent[v]]++;
+        }
+        vector<int64_t> depths(max_depth + 1, 0);
+        Histograms subtree_sizes(max_depth + 1), children(max_depth + 1), interval_sizes(max_depth + 1);
+        for(int64_t v = 0; v < n_nodes; v++){
+            int64_t occurrences = v > 0 ? count_occurrences(s, strings[v]) : 0;
+            depths[depth[v]]++;
+            subtree_sizes[depth[v]][subtree_size[v]]++;
+            children[depth[v]][n_children[v]]++;
+            interval_sizes[depth[v]][v == 0 ? index.size() : occurrences]++;
+        }
+
+        for(bool smallest_first : {false, true}){
+            Suffix_link_tree_statistics_visitor visitor(stop_at_dollars);
+            traverse_suffix_link_tree(index, visitor, smallest_first);
+            if(visitor.nodes != n_nodes || visitor.depths != depths) return false;
+            auto to_maps = [](const vector<Suffix_link_tree_statistics_visitor::Histogram>& histograms){
+                Histograms maps;
+                for(auto& h : histograms) maps.push_back(map<int64_t, int64_t>(h.begin(), h.end()));
+                return maps;
+            };
+            if(to_maps(visitor.subtree_sizes) != subtree_sizes) return false;
+            if(to_maps(visitor.children) != children) return false;
+            if(to_maps(visitor.interval_sizes) != interval_sizes) return false;
+        }
+    }
+    return true;
+}
+
+// Writes the tree in the binary edge list format with the iterator and with the parallel traversal,
+// and compares the edges read back with the dot output
+bool test_binary_edge_list(const BD_BWT_index<>& index){
+    string expected = iterator_output(index, false, false);
+    string filename = "test_binary_edge_list.bin";
+    for(int64_t threads : {1, 3}){
+        {
+            Output_buffer out(filename);
+            out.begin_binary_edge_list();
+            if(threads == 1){
+                BD_BWT_index_iterator<sdsl::bit_vector> it(&index, false, &out);
+                while(it.next());
+            } else{
+                BD_BWT_index_parallel_traversal<sdsl::bit_vector> traversal(&index, threads);
+                traversal.print(out);
+            }
+            out.end_binary_edge_list({'a','b'});
+        }
+        Binary_edge_list list(filename);
+        stringstream dot;
+        list.for_each_edge([&dot](int64_t from, int64_t to, uint8_t c){
+            dot << from << " -> " << to << " [label=\"" << c << "\"];\n";
+        });
+        if(dot.str() != expected) return false;
+        if(list.alphabet() != vector<uint8_t>({'a','b'})) return false;
+        
+        vector<int64_t> offsets, children;
+        vector<uint8_t> labels;
+        list.build_csr(offsets, children, labels);
+        if((int64_t)offsets.size() != list.nodes() + 1 || offsets.back() != list.edges()) return false;
+        for(int64_t v = 0; v < list.nodes(); v++){
+            for(int64_t i = offsets[v]; i < offsets[v+1]; i++){
+                stringstream edge;
+                edge << v << " -> " << children[i] << " [label=\"" << labels[i] << "\"];\n";
+                if(expected.find(edge.str()) == string::npos) return false;
+            }
+        }
+    }
+    remove(filename.c_str());
+    return true;
+}
+
+// Builds the balanced parentheses tree from the iterator, stores and loads it, and compares
+// its navigation queries to the tree seen by the iterator
+bool test_bp_suffix_link_tree(const BD_BWT_index<>& index){
+    BD_BWT_index_iterator<sdsl::bit_vector> it(&index);
+    it.print_edges = false;
+    BP_suffix_link_tree::Builder builder;
+    vector<int64_t> parents, depths, path;
+    vector<uint8_t> labels;
+    vector<string> strings;
+    while(it.next()){
+        int64_t v = parents.size();
+        path.resize(it.current.depth);
+        parents.push_back(path.empty() ? -1 : path.back());
+        path.push_back(v);
+        depths.push_back(it.current.depth);
+        labels.push_back(it.current.extension);
+        strings.push_back(string(it.label.rbegin(), it.label.rend()));
+        builder.add_node(it.current.depth, it.current.extension);
+    }
+    BP_suffix_link_tree built;
+    builder.finish(built);
+    stringstream buffer;
+    built.serialize(buffer);
+    BP_suffix_link_tree tree;
+    tree.load(buffer);
+    
+    int64_t n = parents.size();
+    vector<int64_t> subtree_sizes(n, 1);
+    vector<vector<int64_t>> children(n);
+    for(int64_t v = n-1; v > 0; v--) subtree_sizes[parents[v]] += subtree_sizes[v];
+    for(int64_t v = 1; v < n; v++) children[parents[v]].push_back(v);
+    if(tree.size() != n) return false;
+    for(int64_t v = 0; v < n; v++){
+        if(tree.parent(v) != parents[v] || tree.depth(v) != depths[v] || tree.label(v) != labels[v]) return false;
+        if(tree.subtree_size(v) != subtree_sizes[v] || tree.children(v) != children[v]) return false;
+        if(tree.node_string(v) != strings[v]) return false;
+    }
+    return true;
+}
+
+bool test_parallel_construction(const BD_BWT_index<sdsl::bit_vector>& index, const string& s){
+    BD_BWT_index_construction_config config;
+    config.parallel = true;
+    BD_BWT_index<> parallel_index((const uint8_t*)s.c_str(), config);
+    if(!parallel_index.get_construction_stats().parallel) return false;
+    if(parallel_index.size() != index.size()) return false;
+    if(parallel_index.get_alphabet() != index.get_alphabet()) return false;
+    if(parallel_index.get_global_c_array() != index.get_global_c_array()) return false;
+    for(int64_t i = 0; i < index.size(); i++){
+        if(parallel_index.forward_bwt_at(i) != index.forward_bwt_at(i)) return false;
+        if(parallel_index.backward_bwt_at(i) != index.backward_bwt_at(i)) return false;
+    }
+    return true;
+}
+
+// Indexes s with the character 'a' replaced by 0x00, given as a pointer and a length,
+// and as a vector that the construction consumes
+bool test_zero_bytes(const BD_BWT_index<sdsl::bit_vector>& index, const string& s){
+    string z = s;
+    replace(z.begin(), z.end(), 'a', '\0');
+    BD_BWT_index<> zero_index((const uint8_t*)z.data(), z.size());
+    if(!test_suffix_link_tree_iteration(zero_index, z)) return false;
+    if(!test_backward_step(zero_index, z)) return false;
+    if(!test_forward_step(zero_index, z)) return false;
+    if(!test_extensions(zero_index)) return false;
+    
+    BD_BWT_index<> vector_index(vector<uint8_t>(s.begin(), s.end()));
+    if(vector_index.get_alphabet() != index.get_alphabet()) return false;
+    for(int64_t i = 0; i < index.size(); i++){
+        if(vector_index.forward_bwt_at(i) != index.forward_bwt_at(i)) return false;
+        if(vector_index.backward_bwt_at(i) != index.backward_bwt_at(i)) return false;
+    }
+    return true;
+}
+
+bool test_semi_external_construction(const BD_BWT_index<sdsl::bit_vector>& index, const string& s){
+    BD_BWT_index_construction_config config;
+    config.semi_external = true;
+    BD_BWT_index<> semi_external_index((const uint8_t*)s.c_str(), config);
+    if(!semi_external_index.get_construction_stats().semi_external) return false;
+    if(semi_external_index.size() != index.size()) return false;
+    if(semi_external_index.get_alphabet() != index.get_alphabet()) return false;
+    if(semi_external_index.get_global_c_array() != index.get_global_c_array()) return false;
+    for(int64_t i = 0; i < index.size(); i++){
+        if(semi_external_index.forward_bwt_at(i) != index.forward_bwt_at(i)) return false;
+        if(semi_external_index.backward_bwt_at(i) != index.backward_bwt_at(i)) return false;
+    }
+    return true;
+}
+
+bool test_serialization(const BD_BWT_index<sdsl::bit_vector>& index, string& s){
+    stringstream buffer;
+    index.serialize(buffer);
+    BD_BWT_index<> loaded;
+    loaded.load(buffer);
+    if(loaded.size() != index.size()) return false;
+    if(loaded.get_alphabet() != index.get_alphabet()) return false;
+    if(loaded.get_global_c_array() != index.get_global_c_array()) return false;
+    for(int64_t i = 0; i < index.size(); i++){
+        if(loaded.forward_bwt_at(i) != index.forward_bwt_at(i)) return false;
+        if(loaded.backward_bwt_at(i) != index.backward_bwt_at(i)) return false;
+    }
+    if(!test_suffix_link_tree_iteration(loaded, s)) return false;
+    
+    // Flipping a byte of the payload must be caught by the checksum
+    string corrupted = buffer.str();
+    corrupted[corrupted.size() - 9] ^= 0x40;
+    stringstream corrupted_buffer(corrupted);
+    try{
+        BD_BWT_index<> broken;
+        broken.load(corrupted_buffer);
+        return false;
+    } catch(std::runtime_error& e){}
+    return true;
+}
+
+bool test_mapped_loading(const BD_BWT_index<sdsl::bit_vector>& index, string& s){
+    string filename = "test_mapped_index.tmp";
+    BD_BWT_index<Mapped_bit_vector_il<>> built((const uint8_t*)s.c_str());
+    built.store_to_file(filename);
+    BD_BWT_index<Mapped_bit_vector_il<>> copied, mapped, verified;
+    copied.load_from_file(filename);
+    mapped.load_mapped(filename);
+    verified.load_mapped(filename, true);
+    remove(filename.c_str());
+    
+    for(const BD_BWT_index<Mapped_bit_vector_il<>>* loaded : {&built, &copied, &mapped, &verified}){
+        if(loaded->size() != index.size()) return false;
+        if(loaded->get_alphabet() != index.get_alphabet()) return false;
+        if(loaded->get_global_c_array() != index.get_global_c_array()) return false;
+        for(int64_t i = 0; i < index.size(); i++){
+            if(loaded->forward_bwt_at(i) != index.forward_bwt_at(i)) return false;
+            if(loaded->backward_bwt_at(i) != index.backward_bwt_at(i)) return false;
+            if(loaded->backward_step(i) != index.backward_step(i)) return false;
+            if(loaded->forward_step(i) != index.forward_step(i)) return false;
+        }
+        if(!test_suffix_link_tree_iteration(*loaded, s)) return false;
+        if(!test_extensions(*loaded)) return false;
+    }
+    return true;
+}
+
+// A mapped load points into the mapping without copying, and a corrupted word count fails with
+// runtime_error in both the mapped and the copying load
+bool test_mapped_words(){
+    sdsl::int_vector<64> v(1000);
+    for(uint64_t i = 0; i < v.size(); i++) v[i] = i * 0x9E3779B97F4A7C15ULL;
+    stringstream out;
+    Mapped_words(std::move(v)).serialize(out);
+    string bytes = out.str();
+    vector<uint64_t> storage(bytes.size() / 8 + 1); // Aligned like a mapping
+    char* begin = (char*)storage.data();
+    memcpy(begin, bytes.data(), bytes.size());
+
+    Mapped_streambuf buf(begin, begin + bytes.size());
+    istream in(&buf);
+    Mapped_words mapped;
+    mapped.load(in);
+    if(!mapped.is_mapped() || mapped.owned_bytes() != 0 || mapped.size() != 1000) return false;
+    if((const char*)mapped.data() < begin || (const char*)(mapped.data() + mapped.size()) > begin + bytes.size()) return false;
+    for(uint64_t i = 0; i < mapped.size(); i++) if(mapped[i] != i * 0x9E3779B97F4A7C15ULL) return false;
+
+    // Counts whose byte size wraps around to 0 or is just past the end of the data
+    for(uint64_t n : {(uint64_t)1 << 61, (uint64_t)-1, (uint64_t)1001, (uint64_t)1 << 40}){
+        memcpy(begin, &n, sizeof(n));
+        Mapped_streambuf corrupted_buf(begin, begin + bytes.size());
+        istream corrupted(&corrupted_buf);
+        try{
+            Mapped_words words;
+            words.load(corrupted);
+            return false;
+        } catch(std::runtime_error& e){}
+        string copied_bytes(begin, bytes.size());
+        stringstream copied(copied_bytes);
+        try{
+            Mapped_words words;
+            words.load(copied);
+            return false;
+        } catch(std::runtime_error& e){}
+    }
+    return true;
+}
+
+bool test_dna_bwt(const BD_BWT_index<sdsl::bit_vector>& index, string& s){
+    typedef BD_BWT_index<sdsl::bit_vector, DNA_bwt> DNA_index;
+    DNA_index built((const uint8_t*)s.c_str());
+    stringstream buffer;
+    built.serialize(buffer);
+    DNA_index loaded;
+    loaded.load(buffer);
+    DNA_index copied = loaded;
+    
+    for(const DNA_index* dna_index : {&built, &loaded, &copied}){
+        if(dna_index->size() != index.size()) return false;
+        if(dna_index->get_alphabet() != index.get_alphabet()) return false;
+        if(dna_index->get_global_c_array() != index.get_global_c_array()) return false;
+        for(int64_t i = 0; i < index.size(); i++){
+            if(dna_index->forward_bwt_at(i) != index.forward_bwt_at(i)) return false;
+            if(dna_index->backward_bwt_at(i) != index.backward_bwt_at(i)) return false;
+            if(dna_index->backward_step(i) != index.backward_step(i)) return false;
+            if(dna_index->forward_step(i) != index.forward_step(i)) return false;
+        }
+        if(!test_suffix_link_tree_iteration(*dna_index, s)) return false;
+        if(!test_extensions(*dna_index)) return false;
+    }
+    return true;
+}
+
+// Line by line as in the FASTA reader that Sequence_parser replaced. The last line need not end in a newline.
+string concatenate_sequences_reference(const string& file, char separator){
+    string data, read;
+    bool fastq = false;
+    for(char c : file) if(!isspace((unsigned char)c)){ fastq = c == '@'; break; }
+    vector<string> lines;
+    stringstream in(file);
+    for(string line; getline(in, line);){
+        size_t begin = 0, end = line.size();
+        while(begin < end && isspace((unsigned char)line[begin])) begin++;
+        while(end > begin && isspace((unsigned char)line[end - 1])) end--;
+        lines.push_back(line.substr(begin, end - begin));
+    }
+    for(size_t i = 0; i < lines.size(); i++){
+        if(fastq){
+            if(lines[i].empty()) continue;
+            if(!lines[i + 1].empty()) data += separator + lines[i + 1];
+            i += 3;
+        } else if(lines[i].empty()) continue;
+        else if(lines[i][0] == '>'){
+            if(!read.empty()) data += separator + read;
+            read.clear();
+        } else read += lines[i];
+    }
+    if(!read.empty()) data += separator + read;
+    for(char& c : data) c = toupper(c);
+    return data;
+}
+
+// Random FASTA and FASTQ files with lowercase, CRLF line ends, empty records, blank lines and no
+// final newline, parsed with many small chunks and from a mapped file
+bool test_sequence_parser(){
+    std::mt19937 rng(4321);
+    string filename = "test_sequence_parser.tmp";
+    for(int64_t round = 0; round < 200; round++){
+        bool fastq = round % 2 == 1;
+        string file = round % 10 == 0 ? "acgt\n\n" : ""; // Sequence before the first header
+        if(fastq) file = round % 10 == 1 ? "\n" : "";
+        int64_t n_records = rng() % 20;
+        for(int64_t r = 0; r < n_records; r++){
+            string newline = rng() % 4 == 0 ? "\r\n" : "\n";
+            string read;
+            int64_t length = rng() % 5 == 0 ? 0 : rng() % 200;
+            for(int64_t i = 0; i < length; i++) read += "ACGTNacgtn"[rng() % 10];
+            if(fastq){
+                string qualities;
+                for(int64_t i = 0; i < length; i++) qualities += "@+!I#"[rng() % 5];
+                file += "@r" + to_string(r) + newline + read + newline + "+" + newline + qualities + newline;
+            } else{
+                file += ">r" + to_string(r) + " description" + newline;
+                for(int64_t i = 0; i < length; i += 1 + rng() % 60){
+                    file += read.substr(i, 60) + newline;
+                    if(rng() % 10 == 0) file += "  " + newline;
+                }
+            }
+        }
+        if(rng() % 2 == 0 && !file.empty()) file.pop_back(); // No final newline
+        string expected = concatenate_sequences_reference(file, '$');
+
+        FILE* out = fopen(filename.c_str(), "wb");
+        fwrite(file.data(), 1, file.size(), out);
+        fclose(out);
+        Input_file input(filename);
+        if(input.size != (int64_t)file.size() || string(input.data, input.data + input.size) != file) return false;
+        Sequence_parser parser(input.data, input.size, '$');
+        if(n_records > 0 && parser.is_fastq() != fastq) return false;
+        for(int64_t n_threads : {1, 2, 3, 8, 64}){
+            parser.min_chunk_size = 1 + rng() % 50;
+            vector<uint8_t> text = parser.parse(n_threads, 2);
+            if(string(text.begin(), text.end()) != expected) return false;
+            if(text.capacity() < text.size() + 2) return false;
+        }
+    }
+    remove(filename.c_str());
+
+    // A record without its '+' line
+    string broken = "@r1\nACGT\n+\nIIII\n@r2\nACGT\nIIII\n";
+    try{
+        Sequence_parser((const uint8_t*)broken.data(), broken.size(), '$').parse(1);
+        return false;
+    } catch(std::runtime_error& e){}
+    return true;
+}
+
+// Reads the same bytes through a pipe, in several blocks, and mapped from a regular file
+bool test_input_file(){
+    std::mt19937 rng(8765);
+    for(int64_t n : {0, 1000, 3 * (1 << 24) + 12345}){
+        string bytes(n, 0);
+        for(char& c : bytes) c = "\0ab$"[rng() % 4];
+        int fds[2];
+        if(pipe(fds) != 0) return false;
+        std::thread writer([&](){
+            for(int64_t written = 0; written < n;){
+                ssize_t got = write(fds[1], bytes.data() + written, n - written);
+                if(got <= 0) break;
+                written += got;
+            }
+            close(fds[1]);
+        });
+        Input_file piped("/dev/fd/" + to_string(fds[0]));
+        writer.join();
+        close(fds[0]);
+        if(piped.mapped() || string(piped.data, piped.data + piped.size) != bytes) return false;
+        vector<uint8_t> released = piped.release();
+        if(string(released.begin(), released.end()) != bytes || released.capacity() < released.size() + 1) return false;
+        if(n != 1000) continue;
+
+        BD_BWT_index<> from_pipe(std::move(released));
+        BD_BWT_index<> from_string((const uint8_t*)bytes.data(), bytes.size());
+        string filename = "test_input_file.tmp";
+        FILE* out = fopen(filename.c_str(), "wb");
+        fwrite(bytes.data(), 1, bytes.size(), out);
+        fclose(out);
+        Input_file file(filename);
+        if(!file.mapped()) return false;
+        BD_BWT_index<> from_mapping(file.data, file.size);
+        remove(filename.c_str());
+        for(int64_t i = 0; i < from_string.size(); i++){
+            if(from_pipe.forward_bwt_at(i) != from_string.forward_bwt_at(i)) return false;
+            if(from_mapping.backward_bwt_at(i) != from_string.backward_bwt_at(i)) return false;
+        }
+    }
+    return true;
+}
+
 int main(int argc, char** argv){
     
     vector<string> test_set = all_binary_strings_up_to(10);
@@ -103,8 +964,45 @@ int main(int argc, char** argv){
         assert(test_suffix_link_tree_iteration(index,s));
         assert(test_backward_step(index,s));
         assert(test_forward_step(index,s));
+        assert(test_extensions(index));
+        assert(test_zero_bytes(index,s));
+        assert(test_dna_bwt(index,s));
+        if(s.size() == 10) assert(test_parallel_construction(index,s));
+        if(s.size() == 10) assert(test_parallel_traversal(index));
+        if(s.size() == 10) assert(test_visitor_traversal(index));
+        if(s.size() == 10) assert(test_smallest_first(index));
+        if(s.size() == 10) assert(test_level_order_traversal(index));
+        if(s.size() == 10) assert(test_suffix_link_tree_statistics(index,s));
+        if(s.size() == 10) assert(test_pruning(index,s));
+        if(s.size() == 10) assert(test_binary_edge_list(index));
+        if(s.size() == 10) assert(test_bp_suffix_link_tree(index));
+        if(s.size() == 10) assert(test_semi_external_construction(index,s));
+        if(s.size() == 10) assert(test_serialization(index,s));
+        if(s.size() == 10) assert(test_mapped_loading(index,s));
     }
     
+    assert(test_concurrent_queries());
+    assert(test_mapped_words());
+    assert(test_sequence_parser());
+    assert(test_input_file());
+    
+    // A larger tree so that the workers steal from each other
+    std::mt19937 rng(5678);
+    string random_string;
+    for(int64_t i = 0; i < 5000; i++) random_string += "acgt$"[rng() % 5];
+    assert(test_parallel_traversal(BD_BWT_index<>((const uint8_t*)random_string.c_str())));
+    assert(test_visitor_traversal(BD_BWT_index<>((const uint8_t*)random_string.c_str())));
+    assert(test_smallest_first(BD_BWT_index<>((const uint8_t*)random_string.c_str())));
+    assert(test_level_order_traversal(BD_BWT_index<>((const uint8_t*)random_string.c_str())));
+    assert(test_suffix_link_tree_statistics(BD_BWT_index<>((const uint8_t*)random_string.c_str()), random_string));
+    assert(test_pruning(BD_BWT_index<>((const uint8_t*)random_string.c_str()), random_string));
+    assert(test_extensions(BD_BWT_index<>((const uint8_t*)random_string.c_str())));
+    
+    // A deeper wavelet tree for the batched extensions
+    string random_bytes;
+    for(int64_t i = 0; i < 3000; i++) random_bytes += (char)('0' + rng() % 60);
+    assert(test_extensions(BD_BWT_index<>((const uint8_t*)random_bytes.c_str())));
+    
     cerr << "All tests OK" << endl;
     
 }
\ No newline at end of file
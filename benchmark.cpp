@@ -0,0 +1,823 @@
+#include <iostream>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <fstream>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include "BD_BWT_index.hh"
+#include "Iterators.hh"
+#include "Parallel_traversal.hh"
+#include "Level_order_traversal.hh"
+#include "Output_buffer.hh"
+#include "Binary_edge_list.hh"
+#include "Suffix_link_tree_traversal.hh"
+#include "Input_file.hh"
+#include "Sequence_parser.hh"
+#include <sstream>
+#include <iterator>
+#include <sys/stat.h>
+#include <fcntl.h>
+
+using namespace std;
+
+// Benchmarks of index construction and suffix link tree traversal.
+// The texts are generated in memory, so no input files are needed.
+
+double seconds_since(chrono::steady_clock::time_point start){
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Uniformly random DNA of length n. The same n always gives the same string.
+string random_dna(int64_t n){
+    mt19937_64 rng(n);
+    const char* bases = "ACGT";
+    string s(n, 'A');
+    for(int64_t i = 0; i < n; i++) s[i] = bases[rng() & 3];
+    return s;
+}
+
+// Builds the index of random DNA of each given size and traverses the whole suffix
+// link tree. If throughput in MB/s stays flat as the size grows, construction and
+// traversal scale linearly.
+int scaling(const vector<int64_t>& sizes_mb, bool parallel){
+    BD_BWT_index_construction_config config;
+    config.parallel = parallel;
+    cout.setstate(ios::badbit); // The iterator prints the edges to cout
+    cerr << "size_MB\tconstruction_s\tconstruction_MB/s\tnodes\ttraversal_s\ttraversal_MB/s" << endl;
+    for(int64_t mb : sizes_mb){
+        int64_t n = mb * 1024 * 1024;
+        string s = random_dna(n);
+
+        auto start = chrono::steady_clock::now();
+        BD_BWT_index<> index((const uint8_t*)s.c_str(), config);
+        double construction = seconds_since(start);
+
+        start = chrono::steady_clock::now();
+        BD_BWT_index_iterator<sdsl::bit_vector> it(&index);
+        int64_t nodes = 0;
+        while(it.next()) nodes++;
+        double traversal = seconds_since(start);
+
+        cerr << mb << "\t" << construction << "\t" << mb / construction << "\t"
+             << nodes << "\t" << traversal << "\t" << mb / traversal << endl;
+    }
+    return 0;
+}
+
+// Builds the index of random DNA of each given size in a child process and reports the peak
+// resident memory of the child with and without the text, which takes size_MB itself.
+// In-memory construction uses the vector of the text as its working copy.
+int memory(const vector<int64_t>& sizes_mb, bool semi_external){
+    BD_BWT_index_construction_config config;
+    config.semi_external = semi_external;
+    cerr << "size_MB\tconstruction_s\tpeak_RSS_MB\tpeak_RSS_minus_input_MB\tbytes_per_char" << endl;
+    for(int64_t mb : sizes_mb){
+        int64_t n = mb * 1024 * 1024;
+        int pipe_fds[2];
+        if(pipe(pipe_fds) != 0) return 1;
+        pid_t child = fork();
+        if(child == 0){
+            string s = random_dna(n);
+            vector<uint8_t> text;
+            text.reserve(n + 1); // The construction uses the vector in place, like slt_to_dot does
+            text.assign(s.begin(), s.end());
+            string().swap(s);
+            auto start = chrono::steady_clock::now();
+            BD_BWT_index<> index(std::move(text), config);
+            double construction = seconds_since(start);
+            if(write(pipe_fds[1], &construction, sizeof(construction)) != sizeof(construction)) _exit(1);
+            _exit(0);
+        }
+        double construction = 0;
+        if(read(pipe_fds[0], &construction, sizeof(construction)) != sizeof(construction)) construction = -1;
+        close(pipe_fds[0]); close(pipe_fds[1]);
+        int status = 0;
+        struct rusage usage;
+        wait4(child, &status, 0, &usage);
+        if(!WIFEXITED(status) || WEXITSTATUS(status) != 0){
+            cerr << "Construction of " << mb << " MB failed" << endl;
+            return 1;
+        }
+        double peak_mb = usage.ru_maxrss / 1024.0; // ru_maxrss is in kilobytes on Linux
+        cerr << mb << "\t" << construction << "\t" << peak_mb << "\t" << peak_mb - mb << "\t"
+             << (peak_mb - mb) / mb << endl;
+    }
+    return 0;
+}
+
+// Resident set size of this process in megabytes
+double rss_mb(){
+    ifstream status("/proc/self/status");
+    string line;
+    while(getline(status, line)){
+        if(line.compare(0, 6, "VmRSS:") == 0) return atoll(line.c_str() + 6) / 1024.0;
+    }
+    return 0;
+}
+
+// Loads an index file written by slt_to_dot --save-index by memory-mapping it and by
+// reading it into memory, and reports the startup latency and the resident memory after
+// loading and after traversing the first nodes of the suffix link tree.
+int load(const string& filename, int64_t traversal_nodes){
+    cout.setstate(ios::badbit); // The iterator prints the edges to cout
+    cerr << "mode\tload_s\tload_RSS_MB\ttraversal_s\ttraversal_RSS_MB" << endl;
+    for(string mode : {"mmap", "copy"}){ // mmap first so that the copy does not inflate its RSS
+        double rss_before = rss_mb();
+        auto start = chrono::steady_clock::now();
+        BD_BWT_index<Mapped_bit_vector_il<>> index;
+        try{
+            if(mode == "mmap") index.load_mapped(filename);
+            else index.load_from_file(filename);
+        } catch(std::runtime_error& e){
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        double load_seconds = seconds_since(start);
+        double load_rss = rss_mb() - rss_before;
+
+        start = chrono::steady_clock::now();
+        BD_BWT_index_iterator<Mapped_bit_vector_il<>> it(&index);
+        for(int64_t nodes = 0; nodes < traversal_nodes && it.next(); nodes++);
+        double traversal_seconds = seconds_since(start);
+
+        cerr << mode << "\t" << load_seconds << "\t" << load_rss << "\t"
+             << traversal_seconds << "\t" << rss_mb() - rss_before << endl;
+    }
+    return 0;
+}
+
+// Suffix link tree traversal speed of the index with the given BWT representation
+template<class t_bwt>
+void traverse_backend(const string& name, const string& s){
+    BD_BWT_index<sdsl::bit_vector, t_bwt> index((const uint8_t*)s.data(), s.size());
+    auto start = chrono::steady_clock::now();
+    BD_BWT_index_iterator<sdsl::bit_vector, t_bwt> it(&index);
+    int64_t nodes = 0;
+    while(it.next()) nodes++;
+    double traversal = seconds_since(start);
+    cerr << name << "\t" << nodes << "\t" << traversal << "\t" << nodes / traversal << endl;
+}
+
+// Compares the traversal speed of the Huffman-shaped wavelet trees with DNA_bwt on random DNA
+int backends(int64_t mb){
+    string s = random_dna(mb * 1024 * 1024);
+    cout.setstate(ios::badbit); // The iterator prints the edges to cout
+    cerr << "backend\tnodes\ttraversal_s\tnodes/s" << endl;
+    traverse_backend<sdsl::wt_huff<sdsl::bit_vector>>("wt_huff", s);
+    traverse_backend<DNA_bwt>("DNA_bwt", s);
+    return 0;
+}
+
+// Traverses the suffix link tree of random DNA with each given number of threads, discarding the
+// output. Reports the speedup over one thread and the number of stolen subtrees.
+int threads(int64_t mb, const vector<int64_t>& thread_counts){
+    string s = random_dna(mb * 1024 * 1024);
+    BD_BWT_index<> index((const uint8_t*)s.data(), s.size());
+    cerr << "threads\tnodes\ttraversal_s\tnodes/s\tspeedup\tsteals" << endl;
+    double first = 0;
+    for(int64_t k : thread_counts){
+        ofstream out("/dev/null");
+        BD_BWT_index_parallel_traversal<sdsl::bit_vector> traversal(&index, k);
+        auto start = chrono::steady_clock::now();
+        int64_t nodes = traversal.print(out);
+        double traversal_seconds = seconds_since(start);
+        if(first == 0) first = traversal_seconds;
+        cerr << k << "\t" << nodes << "\t" << traversal_seconds << "\t" << nodes / traversal_seconds << "\t"
+             << first / traversal_seconds << "\t" << traversal.steals << endl;
+    }
+    return 0;
+}
+
+// Writes the given number of synthetic dot edges to /dev/null with Output_buffer and with the
+// chained stream operators that the iterator used before, and reports edges per second
+int writer(int64_t n_edges){
+    cerr << "writer\tedges\tseconds\tedges/s" << endl;
+    auto report = [n_edges](const string& name, double seconds){
+        cerr << name << "\t" << n_edges << "\t" << seconds << "\t" << n_edges / seconds << endl;
+    };
+    
+    int fd = open("/dev/null", O_WRONLY);
+    if(fd < 0) return 1;
+    auto start = chrono::steady_clock::now();
+    {
+        Output_buffer out(fd);
+        for(int64_t i = 0; i < n_edges; i++) out.write_dot_edge(i / 3, i + 1, "ACGT"[i & 3]);
+    }
+    report("Output_buffer", seconds_since(start));
+    close(fd);
+    
+    ofstream stream("/dev/null");
+    start = chrono::steady_clock::now();
+    for(int64_t i = 0; i < n_edges; i++) stream << i / 3 << " -> " << i + 1 << " [label=\"" << "ACGT"[i & 3] << "\"];\n";
+    stream.flush();
+    report("ofstream", seconds_since(start));
+    
+    // Standard output synchronized with stdio, as in slt_to_dot before. Redirect stdout to /dev/null.
+    start = chrono::steady_clock::now();
+    for(int64_t i = 0; i < n_edges; i++) cout << i / 3 << " -> " << i + 1 << " [label=\"" << "ACGT"[i & 3] << "\"];\n";
+    cout.flush();
+    report("cout", seconds_since(start));
+    return 0;
+}
+
+int64_t file_size(const string& filename){
+    struct stat st;
+    return stat(filename.c_str(), &st) == 0 ? st.st_size : -1;
+}
+
+// Writes a random tree with n_edges edges in the dot format of slt_to_dot to the file, for timing
+// tree_statistics on larger trees than slt_to_dot can build in memory. The nodes are numbered like in
+// the traversal: the children of a node get consecutive ids when the node is expanded. Every node has
+// zero or two children, and the root gets two more whenever the tree dies out.
+int dotfile(int64_t n_edges, const string& filename){
+    mt19937_64 rng(n_edges);
+    Output_buffer out(filename);
+    out.write("digraph slt {\n");
+    vector<int64_t> stack;
+    int64_t next_id = 1;
+    auto start = chrono::steady_clock::now();
+    while(next_id <= n_edges){
+        int64_t v = 0;
+        if(!stack.empty()){
+            v = stack.back();
+            stack.pop_back();
+            if(rng() & 1) continue;
+        }
+        for(int64_t k = 0; k < 2 && next_id <= n_edges; k++){
+            out.write_dot_edge(v, next_id, "ACGT"[rng() & 3]);
+            stack.push_back(next_id++);
+        }
+    }
+    out.write("}\n");
+    out.flush();
+    cerr << "Wrote " << n_edges << " edges, " << file_size(filename) << " bytes in " << seconds_since(start) << " seconds" << endl;
+    return 0;
+}
+
+// Writes the suffix link tree of random DNA as dot and as a binary edge list, and compares the
+// file sizes and the time to read the edges back: dot tokenized line by line like tree_statistics,
+// and the binary edge list through Binary_edge_list into CSR adjacency lists
+int edgelist(int64_t mb){
+    string s = random_dna(mb * 1024 * 1024);
+    BD_BWT_index<> index((const uint8_t*)s.data(), s.size());
+    string dot_file = "benchmark_edges.dot", binary_file = "benchmark_edges.bin";
+    for(bool binary : {false, true}){
+        Output_buffer out(binary ? binary_file : dot_file);
+        if(binary) out.begin_binary_edge_list();
+        BD_BWT_index_iterator<sdsl::bit_vector> it(&index, false, &out);
+        while(it.next());
+        if(binary) out.end_binary_edge_list({'A','C','G','T'});
+    }
+    
+    auto start = chrono::steady_clock::now();
+    vector<pair<int64_t,int64_t>> edges;
+    ifstream in(dot_file);
+    string line;
+    while(getline(in, line)){
+        istringstream iss(line);
+        vector<string> tokens((istream_iterator<string>(iss)), istream_iterator<string>());
+        if(tokens.size() == 4) edges.push_back({stoll(tokens[0]), stoll(tokens[2])});
+    }
+    double dot_seconds = seconds_since(start);
+    
+    start = chrono::steady_clock::now();
+    vector<int64_t> offsets, children;
+    vector<uint8_t> labels;
+    {
+        Binary_edge_list list(binary_file);
+        list.build_csr(offsets, children, labels);
+    }
+    double binary_seconds = seconds_since(start);
+    
+    cerr << "format\tedges\tbytes\tbytes/edge\tread_s" << endl;
+    cerr << "dot\t" << edges.size() << "\t" << file_size(dot_file) << "\t" << (double)file_size(dot_file) / edges.size() << "\t" << dot_seconds << endl;
+    cerr << "binary\t" << children.size() << "\t" << file_size(binary_file) << "\t" << (double)file_size(binary_file) / children.size() << "\t" << binary_seconds << endl;
+    cerr << "size reduction " << (double)file_size(dot_file) / file_size(binary_file) << "x, read speedup " << dot_seconds / binary_seconds << "x" << endl;
+    remove(dot_file.c_str());
+    remove(binary_file.c_str());
+    return 0;
+}
+
+// The Fibonacci string of length at least n, cut to n: F_1 = b, F_2 = a, F_k = F_{k-1} F_{k-2}
+string fibonacci_string(int64_t n){
+    string a = "a", b = "b";
+    while((int64_t)a.size() < n){
+        string next = a + b;
+        b.swap(a);
+        a.swap(next);
+    }
+    return a.substr(0, n);
+}
+
+// The string b a b b a b b b a ... of length n. The suffix link tree has a path b, bb, bbb, ...
+// whose nodes all have a small child starting with a, which waits on the stack in the order of the
+// alphabet while the path continues.
+string staircase_string(int64_t n){
+    string s;
+    for(int64_t i = 1; (int64_t)s.size() < n; i++){
+        s += string(i, 'b');
+        s += 'a';
+    }
+    return s.substr(0, n);
+}
+
+// The largest number of frames on the traversal stack on the text in the order of the alphabet and
+// with smallest_first
+void report_stack_size(const string& name, const string& s){
+    BD_BWT_index<> index((const uint8_t*)s.data(), s.size());
+    Suffix_link_tree_visitor nothing;
+    auto start = chrono::steady_clock::now();
+    Suffix_link_tree_traversal_stats alphabet = traverse_suffix_link_tree(index, nothing, false);
+    double alphabet_seconds = seconds_since(start);
+    start = chrono::steady_clock::now();
+    Suffix_link_tree_traversal_stats smallest = traverse_suffix_link_tree(index, nothing, true);
+    double smallest_seconds = seconds_since(start);
+    cerr << name << "\t" << s.size() << "\t" << alphabet.nodes << "\t"
+         << alphabet.max_stack_frames << "\t" << alphabet.max_stack_frames * alphabet.frame_bytes << "\t" << alphabet_seconds << "\t"
+         << smallest.max_stack_frames << "\t" << smallest.max_stack_frames * smallest.frame_bytes << "\t" << smallest_seconds << endl;
+}
+
+// Compares the stack depths of the two traversal orders on a Fibonacci string, random DNA and
+// the given files
+int stack_size(int64_t mb, const vector<string>& files){
+    cerr << "text\tlength\tnodes\talphabet_frames\talphabet_bytes\talphabet_s\tsmallest_frames\tsmallest_bytes\tsmallest_s" << endl;
+    report_stack_size("fibonacci", fibonacci_string(mb * 1024 * 1024));
+    report_stack_size("staircase", staircase_string(mb * 1024 * 1024));
+    report_stack_size("random_dna", random_dna(mb * 1024 * 1024));
+    for(const string& filename : files){
+        ifstream in(filename, ios::binary);
+        string s((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        s.erase(remove(s.begin(), s.end(), '\n'), s.end());
+        report_stack_size(filename, s);
+    }
+    return 0;
+}
+
+// Counts the nodes and the sum of their subtree sizes with the post-order hook
+class Counting_visitor : public Suffix_link_tree_visitor{
+public:
+    int64_t nodes = 0;
+    int64_t subtree_size_sum = 0;
+    vector<int64_t> open; // Node counts at the entry of the nodes on the current path
+    bool on_enter(const Suffix_link_tree_node& v){
+        open.push_back(nodes++);
+        return true;
+    }
+    void on_exit(const Suffix_link_tree_node& v){
+        subtree_size_sum += nodes - open.back();
+        open.pop_back();
+    }
+};
+
+template<class t_int, class t_visitor>
+void report_width(const string& text, const string& visitor_name, const BD_BWT_index<>& index){
+    t_visitor visitor;
+    auto start = chrono::steady_clock::now();
+    Suffix_link_tree_traversal_stats stats = traverse_suffix_link_tree<t_int>(index, visitor);
+    double seconds = seconds_since(start);
+    cerr << text << "\t" << visitor_name << "\t" << 8 * sizeof(t_int) << "\t" << stats.nodes << "\t" << seconds << "\t"
+         << stats.nodes / seconds << "\t" << stats.frame_bytes << "\t" << stats.max_stack_frames * stats.frame_bytes << endl;
+}
+
+// Traverses the suffix link tree of random DNA and of the staircase string with 32-bit and 64-bit
+// stack frames, without and with post-order frames, and reports nodes per second and stack bytes
+int width(int64_t mb){
+    cerr << "text\tvisitor\tbits\tnodes\ttraversal_s\tnodes/s\tframe_bytes\tpeak_stack_bytes" << endl;
+    for(const string& text : {string("random_dna"), string("staircase")}){
+        string s = text == "random_dna" ? random_dna(mb * 1024 * 1024) : staircase_string(mb * 1024 * 1024);
+        BD_BWT_index<> index((const uint8_t*)s.data(), s.size());
+        report_width<int64_t, Suffix_link_tree_visitor>(text, "preorder", index);
+        report_width<uint32_t, Suffix_link_tree_visitor>(text, "preorder", index);
+        report_width<int64_t, Counting_visitor>(text, "postorder", index);
+        report_width<uint32_t, Counting_visitor>(text, "postorder", index);
+    }
+    return 0;
+}
+
+// Prints the suffix link tree of random DNA to /dev/null depth-first and in level order with each
+// given number of threads, and reports nodes per second
+int level_order(int64_t mb, const vector<int64_t>& thread_counts){
+    string s = random_dna(mb * 1024 * 1024);
+    BD_BWT_index<> index((const uint8_t*)s.data(), s.size());
+    int fd = open("/dev/null", O_WRONLY);
+    if(fd < 0) return 1;
+    cerr << "traversal\tthreads\tnodes\ttraversal_s\tnodes/s\tlevels\tmax_level_nodes" << endl;
+    auto start = chrono::steady_clock::now();
+    int64_t nodes = 0;
+    {
+        Output_buffer out(fd);
+        Dot_visitor dot(out);
+        nodes = traverse_suffix_link_tree<uint32_t>(index, dot).nodes;
+    }
+    double seconds = seconds_since(start);
+    cerr << "depth_first\t1\t" << nodes << "\t" << seconds << "\t" << nodes / seconds << "\t-\t-" << endl;
+    for(int64_t k : thread_counts){
+        Output_buffer out(fd);
+        BD_BWT_index_level_order_traversal<sdsl::bit_vector> traversal(&index, k);
+        start = chrono::steady_clock::now();
+        nodes = traversal.print(out);
+        seconds = seconds_since(start);
+        cerr << "level_order\t" << k << "\t" << nodes << "\t" << seconds << "\t" << nodes / seconds << "\t"
+             << traversal.levels << "\t" << traversal.max_level_size << endl;
+    }
+    close(fd);
+    return 0;
+}
+
+// Random bytes except END of length n. The same n always gives the same string.
+string random_bytes(int64_t n){
+    mt19937_64 rng(n);
+    string s(n, 0);
+    for(int64_t i = 0; i < n; i++){
+        uint8_t c = rng() % 255;
+        s[i] = c == BD_BWT_index<>::END ? 0xFF : c;
+    }
+    return s;
+}
+
+// Right-maximality tests per second of the left extensions of the first nodes of the suffix link
+// tree of s, i.e. of the candidate children of the traversal
+void report_maximality(const string& name, const string& s){
+    BD_BWT_index<> index((const uint8_t*)s.data(), s.size());
+    vector<Interval_pair> candidates;
+    BD_BWT_index_iterator<sdsl::bit_vector> it(&index);
+    it.print_edges = false;
+    BD_BWT_index_extensions extensions;
+    while(candidates.size() < 4000000 && it.next()){
+        index.left_extensions(it.current.intervals, extensions);
+        for(int64_t i = 0; i < extensions.count; i++)
+            if(extensions.symbols[i] != BD_BWT_index<>::END) candidates.push_back(extensions.intervals[i]);
+    }
+    BD_BWT_index_extensions scratch;
+    int64_t maximal = 0;
+    auto start = chrono::steady_clock::now();
+    for(const Interval_pair& I : candidates) maximal += index.is_right_maximal(I);
+    double seconds = seconds_since(start);
+    int64_t enumerated = 0;
+    start = chrono::steady_clock::now();
+    for(const Interval_pair& I : candidates){
+        index.right_extensions(I, scratch);
+        enumerated += scratch.count >= 2;
+    }
+    double enumerate_seconds = seconds_since(start);
+    if(enumerated != maximal) cerr << "Error: the tests disagree" << endl;
+    cerr << name << "\t" << index.get_alphabet().size() << "\t" << candidates.size() << "\t" << maximal << "\t"
+         << candidates.size() / seconds << "\t" << candidates.size() / enumerate_seconds << endl;
+}
+
+// Compares is_right_maximal to enumerating all right extensions on random DNA and random bytes
+int maximality(int64_t mb){
+    cerr << "text\tsigma\tcandidates\tmaximal\tis_right_maximal/s\tright_extensions/s" << endl;
+    report_maximality("random_dna", random_dna(mb * 1024 * 1024));
+    report_maximality("random_bytes", random_bytes(mb * 1024 * 1024));
+    return 0;
+}
+
+// Left extensions per second of random intervals by random characters with left_extend_batch
+// for each batch size
+template<class t_bwt>
+void batch_backend(const string& name, const string& s, const vector<int64_t>& batch_sizes){
+    BD_BWT_index<sdsl::bit_vector, t_bwt> index((const uint8_t*)s.data(), s.size());
+    const int64_t n_requests = 1 << 22;
+    mt19937_64 rng(1234);
+    vector<Interval_pair> intervals(n_requests), results(n_requests);
+    vector<uint8_t> symbols(n_requests);
+    for(int64_t k = 0; k < n_requests; k++){
+        int64_t size = 1 + rng() % 16;
+        int64_t forward = rng() % (index.size() - size), reverse = rng() % (index.size() - size);
+        intervals[k] = Interval_pair(forward, forward + size - 1, reverse, reverse + size - 1);
+        symbols[k] = "ACGT"[rng() & 3];
+    }
+    for(int64_t batch : batch_sizes){
+        auto start = chrono::steady_clock::now();
+        for(int64_t k = 0; k < n_requests; k += batch)
+            index.left_extend_batch(&intervals[k], &symbols[k], min(batch, n_requests - k), &results[k]);
+        double seconds = seconds_since(start);
+        cerr << name << "\t" << batch << "\t" << n_requests / seconds << endl;
+    }
+}
+
+// Compares left extensions per second by batch size with both BWT representations on random DNA
+int batch(int64_t mb, const vector<int64_t>& batch_sizes){
+    string s = random_dna(mb * 1024 * 1024);
+    cerr << "backend\tbatch\textensions/s" << endl;
+    batch_backend<sdsl::wt_huff<sdsl::bit_vector>>("wt_huff", s, batch_sizes);
+    batch_backend<DNA_bwt>("DNA_bwt", s, batch_sizes);
+    return 0;
+}
+
+// Traverses the suffix link tree of random DNA with the iterator and with visitors, and reports
+// nodes per second
+int visitor(int64_t mb){
+    string s = random_dna(mb * 1024 * 1024);
+    BD_BWT_index<> index((const uint8_t*)s.data(), s.size());
+    cerr << "traversal\tnodes\ttraversal_s\tnodes/s" << endl;
+    auto report = [](const string& name, int64_t nodes, double seconds){
+        cerr << name << "\t" << nodes << "\t" << seconds << "\t" << nodes / seconds << endl;
+    };
+
+    auto start = chrono::steady_clock::now();
+    BD_BWT_index_iterator<sdsl::bit_vector> it(&index);
+    it.print_edges = false;
+    int64_t nodes = 0;
+    while(it.next()) nodes++;
+    report("iterator", nodes, seconds_since(start));
+
+    start = chrono::steady_clock::now();
+    Counting_visitor counter;
+    traverse_suffix_link_tree(index, counter);
+    report("counting_visitor", counter.nodes, seconds_since(start));
+
+    int fd = open("/dev/null", O_WRONLY);
+    if(fd < 0) return 1;
+    start = chrono::steady_clock::now();
+    {
+        Output_buffer out(fd);
+        Dot_visitor dot(out);
+        traverse_suffix_link_tree(index, dot);
+    }
+    report("dot_visitor", counter.nodes, seconds_since(start));
+    close(fd);
+    cerr << "mean subtree size " << (double)counter.subtree_size_sum / counter.nodes << endl;
+    return 0;
+}
+
+// Random DNA with some of the features of a genome assembly that the pruning rules are for: gaps of
+// 100 N at every 64 kB, and copies of earlier segments of 300 to 6000 bases with 1% of the bases
+// changed, like transposons, making up about a third of the text
+string assembly_like(int64_t n){
+    mt19937_64 rng(n);
+    const char* bases = "ACGT";
+    string s;
+    s.reserve(n);
+    while((int64_t)s.size() < n){
+        if(s.size() % 65536 < 100) s.append(100, 'N');
+        else if(s.size() > 10000 && rng() % 3 == 0){
+            int64_t length = 300 + rng() % 5700;
+            int64_t from = rng() % (s.size() - length);
+            for(int64_t i = 0; i < length; i++) s.push_back(rng() % 100 == 0 ? bases[rng() & 3] : s[from + i]);
+        }
+        else for(int64_t i = 0; i < 1000; i++) s.push_back(bases[rng() & 3]);
+    }
+    s.resize(n);
+    return s;
+}
+
+template<class t_pruning>
+void report_pruning(const string& text, const string& rule, const BD_BWT_index<sdsl::bit_vector, DNA_bwt>& index,
+                    const t_pruning& pruning, int64_t full_nodes, double full_seconds){
+    Suffix_link_tree_visitor nothing;
+    auto start = chrono::steady_clock::now();
+    Suffix_link_tree_traversal_stats stats = traverse_suffix_link_tree(index, nothing, false, pruning);
+    double seconds = seconds_since(start);
+    if(full_nodes == 0){
+        full_nodes = stats.nodes;
+        full_seconds = seconds;
+    }
+    cerr << text << "\t" << rule << "\t" << stats.nodes << "\t" << (double)stats.nodes / full_nodes << "\t"
+         << seconds << "\t" << seconds / full_seconds << endl;
+}
+
+// Traverses the tree of the text with each pruning rule and reports the fraction of the nodes and
+// of the time of the full traversal that is left
+void report_pruning(const string& text, const string& s){
+    BD_BWT_index<sdsl::bit_vector, DNA_bwt> index((const uint8_t*)s.data(), s.size());
+    Suffix_link_tree_visitor nothing;
+    auto start = chrono::steady_clock::now();
+    int64_t full_nodes = traverse_suffix_link_tree(index, nothing).nodes;
+    double full_seconds = seconds_since(start);
+    report_pruning(text, "none", index, Suffix_link_tree_no_pruning(), full_nodes, full_seconds);
+    report_pruning(text, "inactive_policy", index, Suffix_link_tree_pruning(), full_nodes, full_seconds);
+    for(int64_t depth : {12, 20}){
+        Suffix_link_tree_pruning pruning;
+        pruning.max_depth = depth;
+        report_pruning(text, "max_depth_" + to_string(depth), index, pruning, full_nodes, full_seconds);
+    }
+    for(int64_t count : {3, 10}){ // Right-maximal strings occur at least twice anyway
+        Suffix_link_tree_pruning pruning;
+        pruning.min_count = count;
+        report_pruning(text, "min_count_" + to_string(count), index, pruning, full_nodes, full_seconds);
+    }
+    Suffix_link_tree_pruning pruning;
+    pruning.block('N');
+    report_pruning(text, "block_N", index, pruning, full_nodes, full_seconds);
+}
+
+int pruning(int64_t mb, const vector<string>& files){
+    cerr << "text\trule\tnodes\tnode_fraction\ttraversal_s\ttime_fraction" << endl;
+    report_pruning("assembly_like", assembly_like(mb * 1024 * 1024));
+    for(const string& filename : files){
+        ifstream in(filename, ios::binary);
+        string s((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+        s.erase(remove(s.begin(), s.end(), '\n'), s.end());
+        report_pruning(filename, s);
+    }
+    return 0;
+}
+
+// The FASTA parser of slt_to_dot before Sequence_parser, for comparison
+string parse_with_getline(istream& input, char separator){
+    string data, read, line;
+    while(getline(input, line)){
+        size_t begin = 0, end = line.size();
+        while(begin < end && isspace((unsigned char)line[begin])) begin++;
+        while(end > begin && isspace((unsigned char)line[end - 1])) end--;
+        if(begin == end) continue;
+        if(line[begin] == '>'){
+            if(!read.empty()) data += separator + read;
+            read.clear();
+        } else for(size_t i = begin; i < end; i++) read.push_back(toupper(line[i]));
+    }
+    if(!read.empty()) data += separator + read;
+    return data;
+}
+
+// Writes reads of random DNA of 100 to 10000 bases with some lowercase runs, as FASTA with lines
+// of 60 bases or as FASTQ, until the file has about the given size
+void write_sequence_file(const string& filename, int64_t bytes, bool fastq){
+    mt19937_64 rng(bytes);
+    const char* bases = "ACGTacgt";
+    ofstream out(filename, ios::binary);
+    string read;
+    int64_t written = 0;
+    for(int64_t r = 0; written < bytes; r++){
+        read.resize(100 + rng() % 9900);
+        int64_t lowercase = rng() % 4 == 0 ? 4 : 0;
+        for(char& c : read) c = bases[(rng() & 3) + lowercase];
+        string record = (fastq ? "@read" : ">read") + to_string(r) + "\n";
+        if(fastq) record += read + "\n+\n" + string(read.size(), 'I') + "\n";
+        else for(size_t i = 0; i < read.size(); i += 60) record += read.substr(i, 60) + "\n";
+        out << record;
+        written += record.size();
+    }
+}
+
+// Parse throughput of FASTA and FASTQ files with getline and with Sequence_parser on a mapped file
+// with each number of threads. The files are written to the current directory and read once before
+// the timings, so they are in the page cache.
+int parse(int64_t mb, const vector<int64_t>& thread_counts){
+    cerr << "format\tparser\tthreads\tbytes\tseconds\tGB_per_s" << endl;
+    for(bool fastq : {false, true}){
+        string filename = fastq ? "parse_benchmark.fq" : "parse_benchmark.fa";
+        write_sequence_file(filename, mb * 1024 * 1024, fastq);
+        string format = fastq ? "fastq" : "fasta";
+        int64_t bytes = Input_file(filename).size;
+        string expected;
+        if(!fastq){
+            ifstream in(filename);
+            auto start = chrono::steady_clock::now();
+            expected = parse_with_getline(in, '$');
+            double seconds = seconds_since(start);
+            cerr << format << "\tgetline\t1\t" << bytes << "\t" << seconds << "\t" << bytes / seconds / 1e9 << endl;
+        }
+        for(int64_t n_threads : thread_counts){
+            auto start = chrono::steady_clock::now();
+            Input_file input(filename);
+            vector<uint8_t> text = Sequence_parser(input.data, input.size, '$').parse(n_threads);
+            double seconds = seconds_since(start);
+            cerr << format << "\tmapped\t" << n_threads << "\t" << bytes << "\t" << seconds << "\t" << bytes / seconds / 1e9 << endl;
+            if(!fastq && string(text.begin(), text.end()) != expected){
+                cerr << "Error: the parsers disagree" << endl;
+                return 1;
+            }
+        }
+        remove(filename.c_str());
+    }
+    return 0;
+}
+
+void print_instructions(){
+    cerr << "  Usage: ./benchmark scaling [--parallel] size_MB [size_MB ...]" << endl;
+    cerr << "         ./benchmark memory [--semi-external] size_MB [size_MB ...]" << endl;
+    cerr << "         ./benchmark load indexfile [nodes]" << endl;
+    cerr << "         ./benchmark backends size_MB" << endl;
+    cerr << "         ./benchmark threads size_MB threads [threads ...]" << endl;
+    cerr << "         ./benchmark writer edges > /dev/null" << endl;
+    cerr << "         ./benchmark edgelist size_MB" << endl;
+    cerr << "         ./benchmark dotfile edges file" << endl;
+    cerr << "         ./benchmark visitor size_MB" << endl;
+    cerr << "         ./benchmark stack size_MB [file ...]" << endl;
+    cerr << "         ./benchmark width size_MB" << endl;
+    cerr << "         ./benchmark levels size_MB threads [threads ...]" << endl;
+    cerr << "         ./benchmark batch size_MB batch_size [batch_size ...]" << endl;
+    cerr << "         ./benchmark maximal size_MB" << endl;
+    cerr << "         ./benchmark pruning size_MB [file ...]" << endl;
+    cerr << "         ./benchmark parse size_MB threads [threads ...]" << endl;
+    cerr << "  scaling: construction and traversal throughput on random DNA of the given sizes" << endl;
+    cerr << "  memory: peak resident memory of in-memory or semi-external construction on random DNA" << endl;
+    cerr << "  load: startup latency and resident memory of a memory-mapped and a copied" << endl;
+    cerr << "        index file, and after traversing the first nodes (default 1000000) of the tree" << endl;
+    cerr << "  backends: traversal speed in nodes per second with wt_huff and DNA_bwt on random DNA" << endl;
+    cerr << "  threads: parallel traversal speed on random DNA with each number of threads," << endl;
+    cerr << "           e.g. 1 2 4 8 16 32 64 for a scaling curve, relative to the first" << endl;
+    cerr << "  writer: speed of formatting dot edges with Output_buffer and with std::ostream" << endl;
+    cerr << "  edgelist: file size and read time of the tree of random DNA as dot and as a binary edge list" << endl;
+    cerr << "  dotfile: write a random tree with the given number of edges in dot format, e.g. to time" << endl;
+    cerr << "           ./tree_statistics on 1000000000 edges" << endl;
+    cerr << "  visitor: traversal speed with the iterator, a counting visitor and the dot visitor on random DNA" << endl;
+    cerr << "  stack: largest traversal stack in the order of the alphabet and smallest first on a Fibonacci" << endl;
+    cerr << "         string, a staircase string b^1 a b^2 a b^3 a ..., and random DNA of the given size and on" << endl;
+    cerr << "         the given files, e.g. genomes without newlines" << endl;
+    cerr << "  width: traversal speed and stack bytes with 32-bit and 64-bit stack frames" << endl;
+    cerr << "  levels: speed of the depth-first and the level order traversal with each number of threads" << endl;
+    cerr << "  batch: left extensions per second of random intervals of random DNA with left_extend_batch" << endl;
+    cerr << "         for each batch size, e.g. 1 2 4 8 16 64 256" << endl;
+    cerr << "  maximal: right-maximality tests per second of candidate children on random DNA and random bytes," << endl;
+    cerr << "           compared to enumerating all right extensions" << endl;
+    cerr << "  pruning: nodes and traversal time left by --max-depth, --min-count and --block N on a random" << endl;
+    cerr << "           assembly-like text with gaps and repeats of the given size and on the given files, e.g." << endl;
+    cerr << "           genomes of at most 7 distinct characters without newlines" << endl;
+    cerr << "  parse: FASTA and FASTQ parsing speed in GB/s of the getline parser and of the mapped parallel" << endl;
+    cerr << "         parser with each number of threads. Writes the files to the current directory" << endl;
+}
+
+int main(int argc, char** argv){
+    if(argc < 2){
+        print_instructions();
+        return 1;
+    }
+    string mode = argv[1];
+    if(mode == "scaling"){
+        bool parallel = false;
+        vector<int64_t> sizes;
+        for(int i = 2; i < argc; i++){
+            if(string(argv[i]) == "--parallel") parallel = true;
+            else sizes.push_back(atoll(argv[i]));
+        }
+        if(sizes.empty()){
+            print_instructions();
+            return 1;
+        }
+        return scaling(sizes, parallel);
+    }
+    if(mode == "memory"){
+        bool semi_external = false;
+        vector<int64_t> sizes;
+        for(int i = 2; i < argc; i++){
+            if(string(argv[i]) == "--semi-external") semi_external = true;
+            else sizes.push_back(atoll(argv[i]));
+        }
+        if(sizes.empty()){
+            print_instructions();
+            return 1;
+        }
+        return memory(sizes, semi_external);
+    }
+    if(mode == "backends" && argc == 3){
+        return backends(atoll(argv[2]));
+    }
+    if(mode == "threads" && argc >= 4){
+        vector<int64_t> thread_counts;
+        for(int i = 3; i < argc; i++) thread_counts.push_back(atoll(argv[i]));
+        return threads(atoll(argv[2]), thread_counts);
+    }
+    if(mode == "edgelist" && argc == 3){
+        return edgelist(atoll(argv[2]));
+    }
+    if(mode == "dotfile" && argc == 4){
+        return dotfile(atoll(argv[2]), argv[3]);
+    }
+    if(mode == "visitor" && argc == 3){
+        return visitor(atoll(argv[2]));
+    }
+    if(mode == "pruning" && argc >= 3){
+        return pruning(atoll(argv[2]), vector<string>(argv + 3, argv + argc));
+    }
+    if(mode == "parse" && argc >= 4){
+        vector<int64_t> thread_counts;
+        for(int i = 3; i < argc; i++) thread_counts.push_back(atoll(argv[i]));
+        return parse(atoll(argv[2]), thread_counts);
+    }
+    if(mode == "maximal" && argc == 3){
+        return maximality(atoll(argv[2]));
+    }
+    if(mode == "batch" && argc >= 4){
+        vector<int64_t> batch_sizes;
+        for(int i = 3; i < argc; i++) batch_sizes.push_back(atoll(argv[i]));
+        return batch(atoll(argv[2]), batch_sizes);
+    }
+    if(mode == "levels" && argc >= 4){
+        vector<int64_t> thread_counts;
+        for(int i = 3; i < argc; i++) thread_counts.push_back(atoll(argv[i]));
+        return level_order(atoll(argv[2]), thread_counts);
+    }
+    if(mode == "width" && argc == 3){
+        return width(atoll(argv[2]));
+    }
+    if(mode == "stack" && argc >= 3){
+        return stack_size(atoll(argv[2]), vector<string>(argv + 3, argv + argc));
+    }
+    if(mode == "writer" && argc == 3){
+        return writer(atoll(argv[2]));
+    }
+    if(mode == "load" && (argc == 3 || argc == 4)){
+        return load(argv[2], argc == 4 ? atoll(argv[3]) : 1000000);
+    }
+    print_instructions();
+    return 1;
+}
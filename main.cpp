@@ -3,74 +3,283 @@
 #include <fstream>
 #include <cstdlib>
 #include "BD_BWT_index.hh"
-#include "Iterators.hh"
+#include "Suffix_link_tree_traversal.hh"
+#include "Parallel_traversal.hh"
+#include "Level_order_traversal.hh"
+#include "Suffix_link_tree_statistics.hh"
+#include "Suffix_link_tree_pruning.hh"
+#include "Output_buffer.hh"
+#include "BP_suffix_link_tree.hh"
+#include "io_tools.hh"
+#include "Input_file.hh"
+#include "Sequence_parser.hh"
 #include <streambuf>
 #include <utility>
 #include <string>
+#include <memory>
+#include <limits>
+#include <unistd.h>
 
 using namespace std;
 
-void ltrim(std::string &s) {
-    s.erase(s.begin(), std::find_if(s.begin(), s.end(), std::not1(std::ptr_fun<int, int>(std::isspace))));
+void print_instructions(){
+    cerr << "  Usage: ./slt_to_dot -f inputfile [-o outputfile] [--binary | --bp | --stats] [--fasta] [--debug] [--dna] [--parallel]" << endl;
+    cerr << "                      [--semi-external] [--tmp-dir dir] [--max-memory MB] [--timings] [--threads k]" << endl;
+    cerr << "                      [--smallest-first | --level-order] [--max-depth d] [--min-count k] [--block chars]" << endl;
+    cerr << "                      [--save-index indexfile]" << endl;
+    cerr << "         ./slt_to_dot --load-index indexfile [-o outputfile] [--binary | --bp | --stats] [--mmap] [--fasta] [--debug] [--threads k]" << endl;
+    cerr << "                      [--smallest-first | --level-order] [--max-depth d] [--min-count k] [--block chars]" << endl;
+    cerr << "  Prints the suffix link tree of the text in the input file to stdout" << endl;
+    cerr << "  Options:" << endl;
+    cerr << "  -f inputfile: The text, or - for the standard input, e.g. zcat x.gz | ./slt_to_dot -f -" << endl;
+    cerr << "  -o outputfile: Write the tree to outputfile instead of stdout" << endl;
+    cerr << "  --binary: Write the tree in the binary edge list format of Binary_edge_list.hh" << endl;
+    cerr << "            instead of dot. The output must be a file" << endl;
+    cerr << "  --bp: Write the tree as balanced parentheses and edge labels for BP_suffix_link_tree.hh" << endl;
+    cerr << "  --stats: Write the numbers of nodes, children, subtree sizes and interval sizes at each" << endl;
+    cerr << "           depth of the tree instead of the tree" << endl;
+    cerr << "  --fasta: Interprets the input file as a fasta-format file," << endl;
+    cerr << "           concatenating all sequences found in the file placing" << endl;
+    cerr << "           dollar symbols between all found sequences. A file whose" << endl;
+    cerr << "           first character is @ is read as fastq" << endl;
+    cerr << "  --debug: Label all nodes with the corresponding substrings" << endl;
+    cerr << "  --dna: Store the BWTs with 3 bits per character for a faster traversal." << endl;
+    cerr << "         The input may contain at most 7 distinct characters, e.g. ACGTN and $" << endl;
+    cerr << "  --parallel: Build the forward and reverse BWTs of the index concurrently" << endl;
+    cerr << "  --semi-external: Build the suffix arrays and BWTs on disk to save memory" << endl;
+    cerr << "  --tmp-dir dir: Directory for the temporary files of --semi-external (default .)" << endl;
+    cerr << "  --max-memory MB: Fall back to sequential index construction if the parallel" << endl;
+    cerr << "                   construction is estimated to need more than MB megabytes," << endl;
+    cerr << "                   and to semi-external construction if even the sequential one would" << endl;
+    cerr << "                   need more" << endl;
+    cerr << "  --timings: Print the timings of the index construction phases to stderr" << endl;
+    cerr << "  --threads k: Traverse the suffix link tree with k threads. The output is the same" << endl;
+    cerr << "               as with one thread" << endl;
+    cerr << "  --smallest-first: Visit the children of every node in increasing order of their sizes." << endl;
+    cerr << "                    Bounds the memory of the traversal, but numbers the nodes differently" << endl;
+    cerr << "  --level-order: Traverse the tree one depth at a time with the nodes of each depth sorted by" << endl;
+    cerr << "                 their BWT intervals, with k threads per depth with --threads k. Prints the same" << endl;
+    cerr << "                 tree, but numbers the nodes in level order" << endl;
+    cerr << "  --max-depth d: Do not search the children of the nodes at depth d" << endl;
+    cerr << "  --min-count k: Leave out the nodes whose strings occur fewer than k times" << endl;
+    cerr << "  --block chars: Do not search the children of the nodes below edges labelled with one of" << endl;
+    cerr << "                 the characters, e.g. N for the gaps of an assembly" << endl;
+    cerr << "  --save-index indexfile: Build the index of the input file, write it to indexfile" << endl;
+    cerr << "                          and exit without printing the tree" << endl;
+    cerr << "  --load-index indexfile: Print the suffix link tree of an index written with" << endl;
+    cerr << "                          --save-index instead of building the index from a file" << endl;
+    cerr << "  --mmap: Use the index file of --load-index in place through a memory mapping" << endl;
+    cerr << "          instead of reading it into memory" << endl;
+    return;
 }
 
-void rtrim(std::string &s) {
-    s.erase(std::find_if(s.rbegin(), s.rend(), std::not1(std::ptr_fun<int, int>(std::isspace))).base(), s.end());
+// Index files use a bitvector whose rank and select structures can be used in place from a memory mapping
+typedef BD_BWT_index<Mapped_bit_vector_il<>> Index_file_index;
+
+// Builds the index of the input file, or of the standard input if the filename is "-". The input may
+// contain 0x00 bytes. FASTA and FASTQ files are parsed in parallel into a buffer that the construction
+// uses in place. Raw input from a pipe is read into such a buffer in large blocks. A regular file is
+// mapped, and the construction makes its working copy from the mapping, so that the text is in memory
+// only once.
+template<class t_index>
+t_index build_index(const string& filename, bool fasta, const BD_BWT_index_construction_config& config){
+    Input_file input(filename);
+    if(fasta){
+        vector<uint8_t> text = Sequence_parser(input.data, input.size, '$').parse();
+        text.push_back('$');
+        return t_index(std::move(text), config);
+    }
+    if(input.mapped()) return t_index(input.data, input.size, config);
+    return t_index(input.release(), config);
 }
 
-void trim(std::string &s) {
-    ltrim(s); rtrim(s);
+// Gives the nodes to a BP_suffix_link_tree::Builder in preorder
+class BP_builder_visitor : public Suffix_link_tree_visitor{
+public:
+    BP_suffix_link_tree::Builder builder;
+    bool stop_at_dollars;
+    BP_builder_visitor(bool stop_at_dollars) : stop_at_dollars(stop_at_dollars) {}
+    bool on_enter(const Suffix_link_tree_node& v){
+        builder.add_node(v.depth, v.extension);
+        return !(stop_at_dollars && v.depth > 0 && v.extension == '$');
+    }
+};
+
+// How to traverse the suffix link tree and what to write
+class Tree_output_options{
+public:
+    bool debug_mode = false;
+    bool fasta = false;
+    bool binary = false;
+    bool bp = false;
+    bool smallest_first = false;
+    bool level_order = false;
+    bool stats = false;
+    Suffix_link_tree_pruning pruning; // --max-depth, --min-count and --block
+    int64_t threads = 1;
+    string output_filename; // Standard output if empty
+};
+
+// Traverses the tree with 32-bit stack frames if the text is short enough
+template<class t_bitvector, class t_bwt, class t_visitor, class t_pruning>
+void traverse(const BD_BWT_index<t_bitvector, t_bwt>& index, t_visitor& visitor, bool smallest_first, const t_pruning& pruning){
+    if(2 * (uint64_t)index.size() <= numeric_limits<uint32_t>::max()) traverse_suffix_link_tree<uint32_t>(index, visitor, smallest_first, pruning);
+    else traverse_suffix_link_tree<int64_t>(index, visitor, smallest_first, pruning);
 }
 
-string parseConcatenate(std::istream &input, char separator){
+// Compiles the tests of the pruning rules out of the traversal if there are none
+template<class t_bitvector, class t_bwt, class t_visitor>
+void traverse(const BD_BWT_index<t_bitvector, t_bwt>& index, t_visitor& visitor, const Tree_output_options& options){
+    if(options.pruning.active()) traverse(index, visitor, options.smallest_first, options.pruning);
+    else traverse(index, visitor, options.smallest_first, Suffix_link_tree_no_pruning());
+}
 
-    string data = "";
-    string read = "";
-    while(true){
-        
-        string line; getline(input,line); trim(line);
-        if(line.size() == 0 && !input.eof()) continue;
-        if(input.eof() || line[0] == '>'){ // Add the current read to the data if it's good
-            if(read.size() != 0){                
-                data += separator + read;
-            }
-         
-            read = "";
-            
-            if(input.eof()) return data;
-            
-        } else{ // Add the characters on the line to the current read
-            for(char c : line){
-                c = toupper(c);
-                read.push_back(c);
-            }
-        }
-    }
+// Writes the tree in the format of BP_suffix_link_tree
+template<class t_bitvector, class t_bwt>
+void store_bp_suffix_link_tree(const BD_BWT_index<t_bitvector, t_bwt>& index, const Tree_output_options& options){
+    BP_builder_visitor visitor(options.fasta);
+    traverse(index, visitor, options);
+    BP_suffix_link_tree tree;
+    visitor.builder.finish(tree);
+    if(options.output_filename == "") tree.serialize(cout);
+    else tree.store_to_file(options.output_filename);
 }
 
-void print_instructions(){
-    cerr << "  Usage: ./slt_to_dot -f inputfile [--fasta] [--debug]" << endl;
-    cerr << "  Prints the suffix link tree of the text in the input file to stdout" << endl;
-    cerr << "  Options:" << endl;
-    cerr << "  --fasta: Interprets the input file as a fasta-format file," << endl;
-    cerr << "           concatenating all sequences found in the file placing" << endl;
-    cerr << "           dollar symbols between all found sequences" << endl;
-    cerr << "  --debug: Label all nodes with the corresponding substrings" << endl;
-    return;
+// Writes the per-depth histograms of Suffix_link_tree_statistics_visitor instead of the tree
+template<class t_bitvector, class t_bwt>
+void print_suffix_link_tree_statistics(const BD_BWT_index<t_bitvector, t_bwt>& index, const Tree_output_options& options){
+    Suffix_link_tree_statistics_visitor visitor(options.fasta);
+    traverse(index, visitor, options);
+    unique_ptr<Output_buffer> out(options.output_filename == "" ? new Output_buffer(STDOUT_FILENO) : new Output_buffer(options.output_filename));
+    visitor.write(*out);
+}
+
+template<class t_bitvector, class t_bwt>
+void print_suffix_link_tree(const BD_BWT_index<t_bitvector, t_bwt>& index, const Tree_output_options& options){
+    if(options.bp){
+        store_bp_suffix_link_tree(index, options);
+        return;
+    }
+    if(options.stats){
+        print_suffix_link_tree_statistics(index, options);
+        return;
+    }
+    bool binary = options.binary;
+    unique_ptr<Output_buffer> out(options.output_filename == "" ? new Output_buffer(STDOUT_FILENO) : new Output_buffer(options.output_filename));
+    if(binary) out->begin_binary_edge_list();
+    else out->write("digraph slt {\n");
+    if(options.level_order){
+        BD_BWT_index_level_order_traversal<t_bitvector, t_bwt> traversal(&index, options.threads);
+        traversal.stop_at_dollars = options.fasta;
+        traversal.pruning = options.pruning;
+        traversal.print(*out);
+    } else if(options.threads > 1){
+        BD_BWT_index_parallel_traversal<t_bitvector, t_bwt> traversal(&index, options.threads, options.debug_mode);
+        traversal.stop_at_dollars = options.fasta;
+        traversal.smallest_first = options.smallest_first;
+        traversal.pruning = options.pruning;
+        traversal.print(*out);
+    } else{
+        Dot_visitor visitor(*out, options.debug_mode, options.fasta);
+        traverse(index, visitor, options);
+    }
+    if(binary){
+        vector<uint8_t> labels = index.get_alphabet();
+        labels.erase(remove(labels.begin(), labels.end(), BD_BWT_index<t_bitvector, t_bwt>::END), labels.end());
+        out->end_binary_edge_list(labels);
+    } else out->write("}\n");
+    out->flush();
 }
 
 
 int main(int argc, char** argv){
-    bool debug_mode = false;
-    bool fasta = false;
+    Tree_output_options options;
+    bool mmap_index = false;
+    bool dna = false;
     string filename;
+    string save_index_filename;
+    string load_index_filename;
+    BD_BWT_index_construction_config construction_config;
     if(argc == 1){
         print_instructions();
         return 1;
     }
     for(int i = 1; i < argc; i++){
-        if(string(argv[i]) == "--debug") debug_mode = true;
-        else if(string(argv[i]) == "--fasta") fasta = true;
+        if(string(argv[i]) == "--debug") options.debug_mode = true;
+        else if(string(argv[i]) == "--fasta") options.fasta = true;
+        else if(string(argv[i]) == "--parallel") construction_config.parallel = true;
+        else if(string(argv[i]) == "--timings") construction_config.print_timings = true;
+        else if(string(argv[i]) == "--mmap") mmap_index = true;
+        else if(string(argv[i]) == "--dna") dna = true;
+        else if(string(argv[i]) == "--binary") options.binary = true;
+        else if(string(argv[i]) == "--bp") options.bp = true;
+        else if(string(argv[i]) == "--smallest-first") options.smallest_first = true;
+        else if(string(argv[i]) == "--level-order") options.level_order = true;
+        else if(string(argv[i]) == "--stats") options.stats = true;
+        else if(string(argv[i]) == "--semi-external") construction_config.semi_external = true;
+        else if(string(argv[i]) == "--tmp-dir"){
+            if(i == argc - 1) {
+                cerr << "Error: give directory after --tmp-dir" << endl;
+                return 1;
+            } else construction_config.tmp_dir = argv[i+1];
+            i++;
+        }
+        else if(string(argv[i]) == "--threads"){
+            if(i == argc - 1 || atoll(argv[i+1]) < 1) {
+                cerr << "Error: give a positive number of threads after --threads" << endl;
+                return 1;
+            } else options.threads = atoll(argv[i+1]);
+            i++;
+        }
+        else if(string(argv[i]) == "--max-depth"){
+            if(i == argc - 1 || atoll(argv[i+1]) < 0) {
+                cerr << "Error: give a nonnegative depth after --max-depth" << endl;
+                return 1;
+            } else options.pruning.max_depth = atoll(argv[i+1]);
+            i++;
+        }
+        else if(string(argv[i]) == "--min-count"){
+            if(i == argc - 1 || atoll(argv[i+1]) < 1) {
+                cerr << "Error: give a positive count after --min-count" << endl;
+                return 1;
+            } else options.pruning.min_count = atoll(argv[i+1]);
+            i++;
+        }
+        else if(string(argv[i]) == "--block"){
+            if(i == argc - 1) {
+                cerr << "Error: give the blocking characters after --block" << endl;
+                return 1;
+            } else for(char c : string(argv[i+1])) options.pruning.block(c);
+            i++;
+        }
+        else if(string(argv[i]) == "--max-memory"){
+            if(i == argc - 1 || atoll(argv[i+1]) < 1 || atoll(argv[i+1]) > numeric_limits<int64_t>::max() / (1024 * 1024)) {
+                cerr << "Error: give a positive memory limit in megabytes after --max-memory" << endl;
+                return 1;
+            } else construction_config.max_memory_bytes = atoll(argv[i+1]) * 1024 * 1024;
+            i++;
+        }
+        else if(string(argv[i]) == "--save-index"){
+            if(i == argc - 1) {
+                cerr << "Error: give filename after --save-index" << endl;
+                return 1;
+            } else save_index_filename = argv[i+1];
+            i++;
+        }
+        else if(string(argv[i]) == "--load-index"){
+            if(i == argc - 1) {
+                cerr << "Error: give filename after --load-index" << endl;
+                return 1;
+            } else load_index_filename = argv[i+1];
+            i++;
+        }
+        else if(string(argv[i]) == "-o"){
+            if(i == argc - 1) {
+                cerr << "Error: give filename after -o" << endl;
+                return 1;
+            } else options.output_filename = argv[i+1];
+            i++;
+        }
         else if(string(argv[i]) == "-f"){
             if(i == argc - 1) {
                 cerr << "Error: give filename after -f" << endl;
@@ -86,38 +295,76 @@ int main(int argc, char** argv){
         
     }
     
-    if(filename == ""){
-        cerr << "Error: missing input file" << endl;
-        print_instructions();
+    if(options.binary && options.debug_mode){
+        cerr << "Error: --binary can not be combined with --debug" << endl;
         return 1;
     }
     
+    if(options.bp && (options.binary || options.debug_mode || options.threads > 1)){
+        cerr << "Error: --bp can not be combined with --binary, --debug or --threads" << endl;
+        return 1;
+    }
     
-    ifstream instream(filename);
-    if(!instream.good()){
-        cerr << "Error: failed to open file " << filename << endl;
+    if(options.level_order && (options.bp || options.debug_mode || options.smallest_first)){
+        cerr << "Error: --level-order can not be combined with --bp, --debug or --smallest-first" << endl;
         return 1;
     }
-    string s;
-    if(fasta) s = parseConcatenate(instream,'$') + "$";
-    else{
-        std::string raw((std::istreambuf_iterator<char>(instream)),
-                    std::istreambuf_iterator<char>());
-        s = raw;
+    
+    if(options.stats && (options.binary || options.bp || options.debug_mode || options.level_order || options.threads > 1)){
+        cerr << "Error: --stats can not be combined with --binary, --bp, --debug, --level-order or --threads" << endl;
+        return 1;
+    }
+    
+    if(mmap_index && load_index_filename == ""){
+        cerr << "Error: --mmap can only be used with --load-index" << endl;
+        return 1;
+    }
+    
+    if(dna && (load_index_filename != "" || save_index_filename != "")){
+        cerr << "Error: --dna can not be combined with --save-index or --load-index" << endl;
+        return 1;
+    }
+    
+    if(load_index_filename != ""){
+        if(filename != "" || save_index_filename != ""){
+            cerr << "Error: --load-index can not be combined with -f or --save-index" << endl;
+            return 1;
+        }
+        Index_file_index index;
+        try{
+            if(mmap_index) index.load_mapped(load_index_filename);
+            else index.load_from_file(load_index_filename);
+            print_suffix_link_tree(index, options);
+        } catch(std::runtime_error& e){
+            cerr << "Error: " << e.what() << endl;
+            return 1;
+        }
+        return 0;
     }
     
-    if(s.size() > 2147483647){ // 2147483647 = 2^31 - 1
-        cerr << "Error: maximum input size is 2147483647 (=2^31 - 1) characters" << endl;
+    if(filename == ""){
+        cerr << "Error: missing input file" << endl;
+        print_instructions();
         return 1;
     }
-    BD_BWT_index<> index((uint8_t*)(s.c_str()));
-    BD_BWT_index_iterator<sdsl::bit_vector> it(&index, debug_mode);
-    if(fasta) it.stop_at_dollars = true;
-    cout << "digraph slt {\n";
-    while(it.next()){
-        // Iterate through the tree. The iterator is printing
-        // the edges in .dot format to stdout
+    
+    
+    try{
+        if(save_index_filename != ""){
+            Index_file_index index = build_index<Index_file_index>(filename, options.fasta, construction_config);
+            index.store_to_file(save_index_filename);
+            return 0;
+        }
+        if(dna){
+            BD_BWT_index<sdsl::bit_vector, DNA_bwt> index = build_index<BD_BWT_index<sdsl::bit_vector, DNA_bwt>>(filename, options.fasta, construction_config);
+            print_suffix_link_tree(index, options);
+            return 0;
+        }
+        BD_BWT_index<> index = build_index<BD_BWT_index<>>(filename, options.fasta, construction_config);
+        print_suffix_link_tree(index, options);
+    } catch(std::runtime_error& e){
+        cerr << "Error: " << e.what() << endl;
+        return 1;
     }
-    cout << "}" << endl;
     
 }
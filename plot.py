@@ -1,31 +1,48 @@
-import numpy as np
 import matplotlib.pyplot as plt
 import sys
 import math
 
-wanted_depth = int(sys.argv[2])
-bucket_width = 5
-buckets = [0] * 100000
-for line in open(sys.argv[1]):
-    depth, size = map(int, line.split())
-    if depth == wanted_depth:
-        buckets[size/bucket_width] += 1
-
-while buckets[-1] == 0: 
-    buckets.pop()
+# Plots the log-binned subtree size histograms written by
+#   ./tree_statistics --histogram tree.dot > histogram.txt
+#
+# Usage: python plot.py histogram.txt depth   (subtree sizes of the nodes at one depth less than --depths)
+#        python plot.py histogram.txt         (depth against subtree size for all nodes)
 
-# HACK TO MAKE LOGARITHM NOT CRASH
-for i in xrange(0,len(buckets)): 
-    buckets[i] += 1
-# END HACK
-
-print(buckets)
+per_depth = {} # depth -> [(min_size, max_size, count)]
+depth_size = [] # [(min_depth, max_depth, min_size, max_size, count)]
+for line in open(sys.argv[1]):
+    fields = line.split()
+    if fields[0] == "subtree_size":
+        depth, min_size, max_size, count = map(int, fields[1:])
+        per_depth.setdefault(depth, []).append((min_size, max_size, count))
+    elif fields[0] == "depth_size":
+        depth_size.append(tuple(map(int, fields[1:])))
 
-# HACK: xrange(1,len(buckets+1)), starting from 1 instead of 0 to make logarithm not crash
-plt.scatter(map(math.log, [bucket_width * x for x in xrange(1,len(buckets)+1)]), map(math.log, buckets))
+# A bin is plotted at the geometric mean of its ends, with its count divided by its width, so that
+# the wider bins of large values are comparable to the narrow ones. Empty bins are not in the file.
+def center(low, high):
+    return math.sqrt(max(low, 1) * high) if high > 0 else 0
 
-#plt.scatter([bucket_width * x for x in xrange(0,len(buckets))], buckets)
-plt.title("Depth " + str(wanted_depth))
-plt.xlabel("Subtree size (log)")
-plt.ylabel("Frequency (log)")
+if len(sys.argv) > 2:
+    wanted_depth = int(sys.argv[2])
+    bins = per_depth.get(wanted_depth, [])
+    if not bins:
+        sys.exit("No histogram for depth " + str(wanted_depth) + ", run tree_statistics with a larger --depths")
+    plt.scatter([center(low, high) for low, high, count in bins],
+                [count / float(high - low + 1) for low, high, count in bins])
+    plt.xscale("log")
+    plt.yscale("log")
+    plt.title("Depth " + str(wanted_depth))
+    plt.xlabel("Subtree size")
+    plt.ylabel("Nodes per subtree size")
+else:
+    plt.scatter([center(min_size, max_size) for min_depth, max_depth, min_size, max_size, count in depth_size],
+                [center(min_depth, max_depth) for min_depth, max_depth, min_size, max_size, count in depth_size],
+                c=[math.log10(count) for min_depth, max_depth, min_size, max_size, count in depth_size],
+                marker="s")
+    plt.colorbar(label="log10(nodes)")
+    plt.xscale("log")
+    plt.yscale("symlog")
+    plt.xlabel("Subtree size")
+    plt.ylabel("Depth")
 plt.show()
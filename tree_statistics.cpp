@@ -1,65 +1,312 @@
 #include <iostream>
 #include <vector>
-#include <fstream>
-#include <cstdlib>
-#include <streambuf>
-#include <utility>
 #include <string>
-#include <sstream>
+#include <thread>
+#include <atomic>
 #include <algorithm>
-#include <iterator>
-#include <utility>
+#include <limits>
+#include <stdexcept>
+#include <cstdlib>
+#include <cstring>
+#include "Binary_edge_list.hh"
+#include "Input_file.hh"
+#include "Output_buffer.hh"
 
 using namespace std;
 
-vector<string> split(string s){
-    // Split s by whitespace
-    istringstream iss(s);
-    vector<string> tokens;
-    copy(istream_iterator<string>(iss),
-         istream_iterator<string>(),
-         back_inserter(tokens));
-    return tokens;
-}
-
-void compute_statistics(int node, int depth, vector<int>& subtree_sizes, 
-                        vector<int>& depths, vector<vector<int> >& children){
-    depths[node] = depth;
-    subtree_sizes[node] = 1; // The node itself is counted in its subtree
-
-    // Add the sizes of the subtrees to the count
-    for(auto child : children[node]){
-        compute_statistics(child, depth+1, subtree_sizes, depths, children);
-        subtree_sizes[node] += subtree_sizes[child];            
+// The start of the first line at or after p. A newline followed by a quote is the label of an edge.
+const char* line_start(const char* begin, const char* p, const char* end){
+    while(p > begin && p < end && !(p[-1] == '\n' && *p != '"')) p++;
+    return p;
+}
+
+bool parse_int(const char*& p, const char* end, int64_t& x){
+    const char* start = p;
+    x = 0;
+    while(p < end && *p >= '0' && *p <= '9' && p - start < 18) x = x * 10 + (*p++ - '0');
+    return p > start;
+}
+
+bool skip_arrow(const char*& p, const char* end){
+    while(p < end && (*p == ' ' || *p == '\t')) p++;
+    if(end - p < 2 || p[0] != '-' || p[1] != '>') return false;
+    p += 2;
+    while(p < end && (*p == ' ' || *p == '\t')) p++;
+    return true;
+}
+
+// Calls f(from, to) for every line "from -> to [label="c"];" of the dot format that starts in [p, end)
+// and skips the other lines. The last line may continue up to file_end.
+template<class F>
+void scan_edges(const char* p, const char* end, const char* file_end, F f){
+    static const char label[] = " [label=\"";
+    while(p < end){
+        int64_t from, to;
+        if(parse_int(p, file_end, from) && skip_arrow(p, file_end) && parse_int(p, file_end, to)){
+            f(from, to);
+            if(file_end - p > 9 && memcmp(p, label, 9) == 0) p += 10; // The label may be a newline
+        }
+        p = (const char*)memchr(p, '\n', file_end - p);
+        if(p == nullptr) return;
+        p++;
     }
 }
 
-int main(int argc, char** argv){
-    vector<pair<int,int> > edges;
-    string line;
-    int nVertices = 0; // Total number of vertices in the tree
-    // Parse .dot input
-    while(getline(cin,line)){
-        vector<string> tokens = split(line);
-        if(tokens.size() == 4){
-            // This line describes an edge
-            int from = stoi(tokens[0]);
-            int to = stoi(tokens[2]);
-            nVertices = max(nVertices, from+1);
-            nVertices = max(nVertices, to+1);
-            edges.push_back({from,to});
+// Runs f(k) for k = 0..n_threads-1 in n_threads threads
+template<class F>
+void run_in_threads(int64_t n_threads, F f){
+    vector<thread> threads;
+    for(int64_t k = 1; k < n_threads; k++) threads.push_back(thread(f, k));
+    f(0);
+    for(thread& t : threads) t.join();
+}
+
+class Chunk_summary{
+public:
+    int64_t edges = 0;
+    int64_t max_id = 0;
+    bool parents_first = true; // Every parent has a smaller id than its child
+};
+
+class Statistics_options{
+public:
+    int64_t threads = max(1u, thread::hardware_concurrency());
+    bool histograms = false; // Write log-binned histograms instead of one line per node
+    int64_t histogram_depths = 100; // Write the subtree size histograms of the depths 0..histogram_depths-1
+};
+
+/*
+ * Logarithmic bins with four bins per power of two. The values 0..7 have their own bins, and the
+ * value v >= 4 with 2^e <= v < 2^(e+1) is in bin 4(e-1) + j, where j is given by the two bits of v
+ * after the highest one. Bin b covers [bin_min(b), bin_max(b)].
+ */
+int64_t log_bin(int64_t v){
+    if(v < 4) return v;
+    int64_t e = 63 - __builtin_clzll(v);
+    return 4 * (e - 1) + ((v >> (e - 2)) & 3);
+}
+
+int64_t bin_min(int64_t b){
+    return b < 4 ? b : (4 + b % 4) << (b / 4 - 1);
+}
+
+int64_t bin_max(int64_t b){
+    return b < 4 ? b : ((5 + b % 4) << (b / 4 - 1)) - 1;
+}
+
+// Adds one to the count of bin b, growing the histogram as needed
+void add_to_bin(vector<int64_t>& histogram, int64_t b){
+    if(b >= (int64_t)histogram.size()) histogram.resize(b + 1, 0);
+    histogram[b]++;
+}
+
+/*
+ * Writes the subtree size histogram of each depth less than max_depths, "subtree_size depth min_size
+ * max_size count", and the two-dimensional histogram of the depths and subtree sizes of all nodes,
+ * "depth_size min_depth max_depth min_size max_size count", with both axes in log_bin bins. Only
+ * nonempty bins are written. The output takes a few kilobytes even for trees of repetitive texts that
+ * are millions of levels deep, so plot.py does not need the line of every node.
+ */
+template<class t_int>
+void write_histograms(const vector<t_int>& depths, const vector<t_int>& subtree_sizes, int64_t max_depths){
+    vector<vector<int64_t>> by_depth, by_depth_bin;
+    for(int64_t v = 0; v < (int64_t)depths.size(); v++){
+        int64_t depth = depths[v], size_bin = log_bin(subtree_sizes[v]);
+        if(depth < max_depths){
+            if(depth >= (int64_t)by_depth.size()) by_depth.resize(depth + 1);
+            add_to_bin(by_depth[depth], size_bin);
+        }
+        int64_t depth_bin = log_bin(depth);
+        if(depth_bin >= (int64_t)by_depth_bin.size()) by_depth_bin.resize(depth_bin + 1);
+        add_to_bin(by_depth_bin[depth_bin], size_bin);
+    }
+
+    Output_buffer out(STDOUT_FILENO);
+    out.write("nodes "); out.write_int(depths.size()); out.put('\n');
+    for(int64_t depth = 0; depth < (int64_t)by_depth.size(); depth++){
+        for(int64_t b = 0; b < (int64_t)by_depth[depth].size(); b++){
+            if(by_depth[depth][b] == 0) continue;
+            out.write("subtree_size "); out.write_int(depth);
+            out.put(' '); out.write_int(bin_min(b));
+            out.put(' '); out.write_int(bin_max(b));
+            out.put(' '); out.write_int(by_depth[depth][b]); out.put('\n');
+        }
+    }
+    for(int64_t d = 0; d < (int64_t)by_depth_bin.size(); d++){
+        for(int64_t b = 0; b < (int64_t)by_depth_bin[d].size(); b++){
+            if(by_depth_bin[d][b] == 0) continue;
+            out.write("depth_size "); out.write_int(bin_min(d));
+            out.put(' '); out.write_int(bin_max(d));
+            out.put(' '); out.write_int(bin_min(b));
+            out.put(' '); out.write_int(bin_max(b));
+            out.put(' '); out.write_int(by_depth_bin[d][b]); out.put('\n');
+        }
+    }
+}
+
+template<class t_int>
+void write_statistics(const vector<t_int>& depths, const vector<t_int>& subtree_sizes, const Statistics_options& options){
+    if(options.histograms){
+        write_histograms(depths, subtree_sizes, options.histogram_depths);
+        return;
+    }
+    Output_buffer out(STDOUT_FILENO);
+    for(int64_t v = 0; v < (int64_t)depths.size(); v++){
+        out.write_int(depths[v]);
+        out.put(' ');
+        out.write_int(subtree_sizes[v]);
+        out.put('\n');
+    }
+}
+
+/*
+ * Computes the depth and subtree size of every node of the tree rooted at node 0, where parent[v]
+ * is the parent of v, and writes them to stdout with write_statistics. If every parent has a smaller
+ * id than its children, as in the output of slt_to_dot, the sizes are summed in decreasing order of
+ * id and the depths replace the parents in increasing order. Otherwise the children are gathered into
+ * CSR adjacency lists and the subtrees of the children of the root are searched iteratively by
+ * options.threads threads. Throws std::runtime_error if the edges do not form such a tree.
+ */
+template<class t_int>
+void compute_statistics(vector<t_int>& parent, bool parents_first, const Statistics_options& options){
+    const t_int none = numeric_limits<t_int>::max();
+    int64_t n = parent.size();
+    if(parent[0] != none) throw runtime_error("The root 0 has a parent");
+    for(int64_t v = 1; v < n; v++)
+        if(parent[v] == none) throw runtime_error("Node " + to_string(v) + " has no parent");
+    vector<t_int> subtree_sizes(n, 1);
+
+    if(parents_first){
+        for(int64_t v = n - 1; v > 0; v--) subtree_sizes[parent[v]] += subtree_sizes[v];
+        parent[0] = 0;
+        for(int64_t v = 1; v < n; v++) parent[v] = parent[parent[v]] + 1;
+        write_statistics(parent, subtree_sizes, options);
+        return;
+    }
+
+    vector<t_int> offsets(n + 1, 0), children(n);
+    for(int64_t v = 1; v < n; v++) offsets[parent[v] + 1]++;
+    for(int64_t v = 0; v < n; v++) offsets[v + 1] += offsets[v];
+    {
+        vector<t_int> next(offsets.begin(), offsets.end() - 1);
+        for(int64_t v = 1; v < n; v++) children[next[parent[v]]++] = v;
+    }
+
+    vector<t_int> depths(n, 0);
+    atomic<int64_t> next_subtree(offsets[0]), visited(1);
+    run_in_threads(options.threads, [&](int64_t thread_id){
+        vector<t_int> order, stack;
+        while(true){
+            int64_t i = next_subtree++;
+            if(i >= (int64_t)offsets[1]) break;
+            order.clear();
+            stack.push_back(children[i]);
+            depths[children[i]] = 1;
+            while(!stack.empty()){ // Preorder
+                t_int v = stack.back(); stack.pop_back();
+                order.push_back(v);
+                for(int64_t j = offsets[v]; j < (int64_t)offsets[v + 1]; j++){
+                    depths[children[j]] = depths[v] + 1;
+                    stack.push_back(children[j]);
+                }
+            }
+            for(int64_t k = order.size() - 1; k > 0; k--) subtree_sizes[parent[order[k]]] += subtree_sizes[order[k]];
+            visited += order.size();
         }
+    });
+    if(visited != n) throw runtime_error("The edges contain a cycle");
+    for(int64_t j = offsets[0]; j < (int64_t)offsets[1]; j++) subtree_sizes[0] += subtree_sizes[children[j]];
+    write_statistics(depths, subtree_sizes, options);
+}
+
+// Parses the edges of the dot file in options.threads parts in two passes: the first counts the edges and
+// finds the largest node id, and the second stores the parent of every node
+template<class t_int>
+void dot_statistics(const Input_file& input, const vector<const char*>& part_starts, const Chunk_summary& total,
+                    const Statistics_options& options){
+    const char* file_end = (const char*)input.data + input.size;
+    vector<t_int> parent(total.max_id + 1, numeric_limits<t_int>::max());
+    run_in_threads(options.threads, [&](int64_t k){
+        scan_edges(part_starts[k], part_starts[k+1], file_end, [&parent](int64_t from, int64_t to){ parent[to] = from; });
+    });
+    compute_statistics(parent, total.parents_first, options);
+}
+
+void dot_statistics(const Input_file& input, Statistics_options options){
+    const char* data = (const char*)input.data;
+    const char* file_end = data + input.size;
+    options.threads = min(options.threads, input.size / (1 << 20) + 1);
+    int64_t n_threads = options.threads;
+    vector<const char*> part_starts;
+    for(int64_t k = 0; k <= n_threads; k++)
+        part_starts.push_back(line_start(data, data + input.size * k / n_threads, file_end));
+
+    vector<Chunk_summary> summaries(n_threads);
+    run_in_threads(n_threads, [&](int64_t k){
+        Chunk_summary& s = summaries[k];
+        scan_edges(part_starts[k], part_starts[k+1], file_end, [&s](int64_t from, int64_t to){
+            s.edges++;
+            s.max_id = max(s.max_id, max(from, to));
+            s.parents_first = s.parents_first && from < to;
+        });
+    });
+    Chunk_summary total;
+    for(const Chunk_summary& s : summaries){
+        total.edges += s.edges;
+        total.max_id = max(total.max_id, s.max_id);
+        total.parents_first = total.parents_first && s.parents_first;
     }
+    // With n-1 edges and a parent for every node except the root, no node has two parents
+    if(total.edges != total.max_id) throw runtime_error("The edges do not form a tree with nodes 0.." + to_string(total.max_id));
 
-    vector<vector<int> > children(nVertices);
-    for(auto E : edges){
-        children[E.first].push_back(E.second);
+    if(total.max_id < numeric_limits<uint32_t>::max()) dot_statistics<uint32_t>(input, part_starts, total, options);
+    else dot_statistics<int64_t>(input, part_starts, total, options);
+}
+
+template<class t_int>
+void binary_statistics(const Binary_edge_list& list, const Statistics_options& options){
+    vector<t_int> parent(list.nodes(), numeric_limits<t_int>::max());
+    list.for_each_edge([&parent](int64_t from, int64_t to, uint8_t c){ parent[to] = from; });
+    compute_statistics(parent, true, options);
+}
+
+// Writes the depth and the subtree size of every node of the suffix link tree, one node per line in
+// the order of the node ids. The input is memory-mapped if it is a file, and scanned by hand in
+// parallel. The tree takes 8 bytes per node if it has fewer than 2^32 nodes, otherwise 16, and
+// 20 or 40 bytes if the parents do not have smaller ids than their children. With --histogram,
+// writes the log-binned histograms of write_histograms instead, for plot.py, with a subtree size
+// histogram for each of the first k depths given by --depths k (default 100).
+//
+// Usage: ./tree_statistics [--threads k] [--histogram [--depths k]] < tree.dot
+//        ./tree_statistics [--threads k] [--histogram [--depths k]] tree.dot
+//        ./tree_statistics [--histogram [--depths k]] --binary tree.bin (written with slt_to_dot --binary)
+int main(int argc, char** argv){
+    Statistics_options options;
+    string filename;
+    bool binary = false;
+    for(int i = 1; i < argc; i++){
+        if(string(argv[i]) == "--binary") binary = true;
+        else if(string(argv[i]) == "--threads" && i + 1 < argc) options.threads = max(1LL, atoll(argv[++i]));
+        else if(string(argv[i]) == "--histogram") options.histograms = true;
+        else if(string(argv[i]) == "--depths" && i + 1 < argc) options.histogram_depths = atoll(argv[++i]);
+        else filename = argv[i];
+    }
+    if(binary && filename == ""){
+        cerr << "Usage: ./tree_statistics [--histogram [--depths k]] --binary tree.bin" << endl;
+        return 1;
     }
 
-    vector<int> subtree_sizes(nVertices);
-    vector<int> depths(nVertices);
-    compute_statistics(0, 0, subtree_sizes, depths, children);
-    for(int i = 0; i < nVertices; i++){
-        cout << depths[i] << " " << subtree_sizes[i] << "\n";
+    try{
+        if(binary){
+            Binary_edge_list list(filename);
+            if(list.nodes() < numeric_limits<uint32_t>::max()) binary_statistics<uint32_t>(list, options);
+            else binary_statistics<int64_t>(list, options);
+            return 0;
+        }
+        Input_file input(filename == "" ? "-" : filename);
+        dot_statistics(input, options);
+    } catch(std::runtime_error& e){
+        cerr << "Error: " << e.what() << endl;
+        return 1;
     }
 }